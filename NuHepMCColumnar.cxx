@@ -0,0 +1,308 @@
+#include "NuHepMC/Columnar.hxx"
+#include "NuHepMC/CompressedStreams.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/Validation.hxx"
+
+#include "HepMC3/ReaderFactory.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " -o <out.nuhepcol> [--block-size N] [--zlib] [--check] [--list] "
+         "<file.hepmc3>\n"
+      << "\t-o <file>          : The columnar output file.\n"
+      << "\t--block-size N     : Events per block, defaults to 16384.\n"
+      << "\t--zlib             : Compress each column that zlib shrinks.\n"
+      << "\t--check            : Read back the converted file and check that "
+         "every\n\t                     event validates the same as the "
+         "original.\n"
+      << "\t--list             : Print the columns of each block of the "
+         "output.\n"
+      << "\n\tOnly the ProcID, LabPos, TotXS, ProcXS and GenCrossSection "
+         "event\n\tattributes are converted, any other event, vertex or "
+         "particle\n\tattribute is dropped and the names of the dropped "
+         "event attributes\n\tare listed in a warning.\n"
+      << std::endl;
+}
+
+struct RunSummary {
+  std::set<std::string> Conventions;
+  NuHepMC::StatusCodeDescriptors ProcessIds;
+  NuHepMC::StatusCodeDescriptors VertexStatuses;
+  NuHepMC::StatusCodeDescriptors ParticleStatuses;
+  // A failure to read the definitions is compared like any other content.
+  std::string error;
+
+  NuHepMC::Validation::RunDefinitions GetDefinitions() const {
+    return {ProcessIds, VertexStatuses, ParticleStatuses};
+  }
+};
+
+RunSummary ReadRunSummary(std::shared_ptr<HepMC3::GenRunInfo> run_info) {
+  RunSummary rs;
+  try {
+    rs.Conventions = NuHepMC::GenRunInfo::ReadConventions(run_info);
+    rs.ProcessIds = NuHepMC::GenRunInfo::ReadProcessIDDefinitions(run_info);
+    rs.VertexStatuses =
+        NuHepMC::GenRunInfo::ReadVertexStatusIDDefinitions(run_info);
+    rs.ParticleStatuses =
+        NuHepMC::GenRunInfo::ReadParticleStatusIDDefinitions(run_info);
+  } catch (std::exception &e) {
+    rs.error = e.what();
+  }
+  return rs;
+}
+
+bool SameDouble(double a, double b) {
+  return (a == b) || ((a != a) && (b != b));
+}
+
+// Returns a description of the first difference between the fields of the
+// original event, a, and the converted event, b, or an empty string.
+std::string Compare(NuHepMC::Validation::EventFields const &a,
+                    NuHepMC::Validation::EventFields const &b) {
+  std::stringstream ss;
+  if (a.evnum != b.evnum) {
+    ss << "event number " << a.evnum << " != " << b.evnum;
+  } else if ((a.ProcID.ok != b.ProcID.ok) ||
+             (a.ProcID.ok && (a.ProcID.value != b.ProcID.value))) {
+    ss << "ProcID";
+  } else if ((a.LabPos.ok != b.LabPos.ok) ||
+             (a.LabPos.ok &&
+              ((a.LabPos.value.size() != b.LabPos.value.size()) ||
+               !std::equal(a.LabPos.value.begin(), a.LabPos.value.end(),
+                           b.LabPos.value.begin(), SameDouble)))) {
+    ss << "LabPos";
+  } else if ((a.TotXS.ok != b.TotXS.ok) ||
+             (a.TotXS.ok && !SameDouble(a.TotXS.value, b.TotXS.value))) {
+    ss << "TotXS";
+  } else if ((a.ProcXS.ok != b.ProcXS.ok) ||
+             (a.ProcXS.ok && !SameDouble(a.ProcXS.value, b.ProcXS.value))) {
+    ss << "ProcXS";
+  } else if (a.has_cross_section != b.has_cross_section) {
+    ss << "GenCrossSection";
+  } else if (a.vertex_statuses != b.vertex_statuses) {
+    ss << "vertex statuses";
+  } else if (a.particle_statuses != b.particle_statuses) {
+    ss << "particle statuses";
+  } else if (a.nbeams != b.nbeams) {
+    ss << "number of beam particles " << a.nbeams << " != " << b.nbeams;
+  } else if ((a.evt && b.evt) &&
+             ((a.evt->weights().size() != b.evt->weights().size()) ||
+              !std::equal(a.evt->weights().begin(), a.evt->weights().end(),
+                          b.evt->weights().begin(), SameDouble))) {
+    ss << "weights";
+  }
+  return ss.str();
+}
+
+// Runs both files through the event-level validation, as
+// NuHepMCReferenceValidator would, and checks that each event gives the same
+// fields and fails the same rule, if any.
+bool Check(std::string const &infile, std::string const &outfile) {
+  auto original = NuHepMC::OpenReader(infile);
+  if (!original) {
+    std::cout << "[ERROR]: Failed to open " << infile << std::endl;
+    return false;
+  }
+  NuHepMC::ColumnarReader converted(outfile);
+
+  HepMC3::GenEvent oevt, cevt;
+  original->read_event(oevt);
+  converted.read_event(cevt);
+
+  auto orun = ReadRunSummary(original->run_info());
+  auto crun = ReadRunSummary(converted.run_info());
+  if ((orun.error != crun.error) || (orun.Conventions != crun.Conventions) ||
+      (orun.ProcessIds != crun.ProcessIds) ||
+      (orun.VertexStatuses != crun.VertexStatuses) ||
+      (orun.ParticleStatuses != crun.ParticleStatuses)) {
+    std::cout << "[ERROR]: The run info of " << outfile
+              << " declares different conventions or definitions to "
+              << infile << std::endl;
+    return false;
+  }
+
+  NuHepMC::Validation::ValidationPlan oplan(orun.Conventions,
+                                            orun.GetDefinitions());
+  NuHepMC::Validation::ValidationPlan cplan(crun.Conventions,
+                                            crun.GetDefinitions());
+  // Everything is compared, not only what the declared conventions need.
+  uint32_t const needs = ~uint32_t(0);
+
+  NuHepMC::Validation::EventFields ofields, cfields;
+  size_t nevents = 0, nfailed = 0;
+  while (!original->failed()) {
+    if (converted.failed()) {
+      std::cout << "[ERROR]: " << outfile << " has fewer events than "
+                << infile << std::endl;
+      return false;
+    }
+
+    NuHepMC::Validation::FillEventFields(oevt, needs, ofields);
+    NuHepMC::Validation::FillEventFields(cevt, needs, cfields);
+    std::string diff = Compare(ofields, cfields);
+    if (diff.size()) {
+      std::cout << "[ERROR]: Event " << ofields.evnum << " at position "
+                << nevents << " differs after conversion: " << diff
+                << std::endl;
+      return false;
+    }
+
+    auto orule = oplan.Check(ofields);
+    auto crule = cplan.Check(cfields);
+    if (bool(orule) != bool(crule) || (orule && (orule->id != crule->id))) {
+      std::cout << "[ERROR]: Event " << ofields.evnum << " at position "
+                << nevents << " "
+                << (orule ? ("fails " + orule->id) : std::string("passes"))
+                << " in " << infile << " but "
+                << (crule ? ("fails " + crule->id) : std::string("passes"))
+                << " in " << outfile << std::endl;
+      return false;
+    }
+    nfailed += bool(orule);
+
+    nevents++;
+    original->read_event(oevt);
+    converted.read_event(cevt);
+  }
+  if (!converted.failed()) {
+    std::cout << "[ERROR]: " << outfile << " has more events than " << infile
+              << std::endl;
+    return false;
+  }
+
+  std::cout << "[INFO]: All " << nevents << " events of " << outfile
+            << " validate the same as " << infile << " (" << nfailed
+            << " failing in both)." << std::endl;
+  return true;
+}
+
+void List(std::string const &filename) {
+  NuHepMC::Columnar::File file(filename);
+  for (size_t b = 0; b < file.NBlocks(); ++b) {
+    auto const &block = file.GetBlock(b);
+    std::cout << "Block " << b << ": events [" << block.first_event << ", "
+              << (block.first_event + block.nevents) << ")" << std::endl;
+    for (auto const &col : block.columns) {
+      std::cout << "\t" << std::left << std::setw(28) << col.name << std::right
+                << std::setw(10) << col.count << " entries" << std::setw(12)
+                << col.stored_size << " bytes"
+                << ((col.codec == NuHepMC::Columnar::Codec::kZlib) ? " (zlib)"
+                                                                   : "")
+                << std::endl;
+    }
+  }
+}
+
+int main(int argc, char const *argv[]) {
+  std::string infile;
+  std::string outfile;
+  size_t block_size = 16384;
+  auto codec = NuHepMC::Columnar::Codec::kNone;
+  bool check = false;
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-o") && ((i + 1) < argc)) {
+      outfile = argv[++i];
+    } else if ((arg == "--block-size") && ((i + 1) < argc)) {
+      block_size = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--zlib") {
+      codec = NuHepMC::Columnar::Codec::kZlib;
+    } else if (arg == "--check") {
+      check = true;
+    } else if (arg == "--list") {
+      list = true;
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else if (infile.empty()) {
+      infile = arg;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (infile.empty() || outfile.empty()) {
+    SayUsage(argv);
+    return 1;
+  }
+  if ((codec == NuHepMC::Columnar::Codec::kZlib) &&
+      !NuHepMC::Columnar::HasZlib()) {
+    std::cout << "[ERROR]: --zlib was passed, but this build has no zlib "
+                 "support."
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    auto reader = NuHepMC::OpenReader(infile);
+    if (!reader) {
+      std::cout << "[ERROR]: Failed to open " << infile << std::endl;
+      return 1;
+    }
+
+    HepMC3::GenEvent evt;
+    reader->read_event(evt);
+    if (!reader->run_info()) {
+      std::cout << "[ERROR]: " << infile << " has no GenRunInfo." << std::endl;
+      return 1;
+    }
+
+    static const std::set<std::string> converted_attributes = {
+        "ProcID", "LabPos", "TotXS", "ProcXS", "GenCrossSection"};
+    std::set<std::string> dropped_attributes;
+
+    size_t nevents = 0;
+    {
+      NuHepMC::ColumnarWriter writer(outfile, reader->run_info(), block_size,
+                                     codec);
+      while (!reader->failed()) {
+        writer.write_event(evt);
+        for (auto const &name : evt.attribute_names()) {
+          if (!converted_attributes.count(name)) {
+            dropped_attributes.insert(name);
+          }
+        }
+        nevents++;
+        reader->read_event(evt);
+      }
+      writer.close();
+    }
+    std::cout << "[INFO]: Wrote " << nevents << " events to " << outfile
+              << std::endl;
+    if (dropped_attributes.size()) {
+      std::cout << "[WARN]: The columnar format does not store these event "
+                   "attributes, which were dropped:";
+      for (auto const &name : dropped_attributes) {
+        std::cout << " " << name;
+      }
+      std::cout << std::endl;
+    }
+
+    if (list) {
+      List(outfile);
+    }
+    if (check && !Check(infile, outfile)) {
+      return 1;
+    }
+  } catch (std::exception &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "NuHepMC/EventIndex.hxx"
+
+#include <iostream>
+#include <string>
+
+void SayUsage(char const *argv[]) {
+  std::cout << "[RUNLIKE]: " << argv[0]
+            << " [-o <index>] [--check] [--list] <file.hepmc3>\n"
+            << "\t-o <index> : Where to write the index, defaults to "
+               "<file.hepmc3>.nuhepmcidx\n"
+            << "\t--check    : Check an existing index against the file "
+               "rather\n\t             than building a new one.\n"
+            << "\t--list     : Print the offset, event number and ProcID of "
+               "each\n\t             indexed event.\n"
+            << std::endl;
+}
+
+int main(int argc, char const *argv[]) {
+  std::string filename;
+  std::string idxfile;
+  bool check = false;
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-o") && ((i + 1) < argc)) {
+      idxfile = argv[++i];
+    } else if (arg == "--check") {
+      check = true;
+    } else if (arg == "--list") {
+      list = true;
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else if (filename.empty()) {
+      filename = arg;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (filename.empty()) {
+    SayUsage(argv);
+    return 1;
+  }
+  if (idxfile.empty()) {
+    idxfile = NuHepMC::EventIndex::GetSidecarName(filename);
+  }
+
+  NuHepMC::EventIndex index;
+  if (check) {
+    index = NuHepMC::EventIndex::Read(idxfile);
+    std::string why;
+    if (!index.IsValidFor(filename, &why)) {
+      std::cout << "[ERROR]: " << idxfile << " does not match " << filename
+                << ": " << why << std::endl;
+      return 1;
+    }
+    std::cout << "[INFO]: " << idxfile << " matches " << filename << std::endl;
+  } else {
+    index = NuHepMC::EventIndex::Build(filename);
+    index.Write(idxfile);
+    std::cout << "[INFO]: Wrote index of " << index.NEvents() << " events to "
+              << idxfile << std::endl;
+  }
+
+  if (list) {
+    for (auto const &e : index.GetEntries()) {
+      std::cout << e.offset << " " << e.evnum << " ";
+      if (e.ProcID == NuHepMC::EventIndex::kNoProcID) {
+        std::cout << "-" << std::endl;
+      } else {
+        std::cout << e.ProcID << std::endl;
+      }
+    }
+  }
+}
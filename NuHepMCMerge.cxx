@@ -0,0 +1,133 @@
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/Merge.hxx"
+#include "NuHepMC/WriterUtils.hxx"
+
+#include "HepMC3/WriterAscii.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " -o <merged.hepmc3> [--first-event N] <shard1.hepmc3> "
+         "[shard2.hepmc3 ...]\n"
+      << "\t-o <file>          : The merged output file.\n"
+      << "\t--first-event N    : Number of the first merged event, events are\n"
+         "\t                     renumbered consecutively, defaults to 1.\n"
+      << "\n\tThe process, vertex status and particle status definitions and "
+         "the\n\tweight names of every shard must match. The merged run info "
+         "sums\n\tthe exposure of the shards and averages their flux-averaged "
+         "total\n\tcross sections, weighted by the number of events in each. "
+         "Each shard\n\tis read once, unless no shard has "
+         "NuHepMC.Exposure.NEvents, in\n\twhich case every shard is first "
+         "read an extra time to count its\n\tevents. Exposure and cross "
+         "section attributes must be present in\n\tevery shard or in "
+         "none.\n"
+         "\tAsciiv3 shards are copied verbatim other than the event number, "
+         "any\n\tother format is read and rewritten as Asciiv3.\n"
+      << std::endl;
+}
+
+bool IsAsciiv3(std::string const &filename) {
+  try {
+    NuHepMC::MappedFile mapped(filename);
+    NuHepMC::AsciiEventScanner scanner(mapped.begin(), mapped.end());
+    return true;
+  } catch (NuHepMC::AsciiScannerException &) {
+    return false;
+  }
+}
+
+int main(int argc, char const *argv[]) {
+  std::string outfile;
+  int first_evnum = 1;
+  std::vector<std::string> shards;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-o") && ((i + 1) < argc)) {
+      outfile = argv[++i];
+    } else if ((arg == "--first-event") && ((i + 1) < argc)) {
+      first_evnum = std::atoi(argv[++i]);
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else {
+      shards.push_back(arg);
+    }
+  }
+
+  if (outfile.empty() || shards.empty()) {
+    SayUsage(argv);
+    return 1;
+  }
+
+  bool all_ascii = true;
+  for (auto const &shard : shards) {
+    all_ascii = all_ascii && IsAsciiv3(shard);
+  }
+
+  size_t nevents = 0;
+  try {
+    if (!all_ascii) {
+      std::cout << "[INFO]: Not all shards are Asciiv3, events will be "
+                   "rewritten."
+                << std::endl;
+      NuHepMC::ConcatenatedReader reader(shards, first_evnum);
+      HepMC3::WriterAscii writer(outfile, reader.run_info());
+      HepMC3::GenEvent evt;
+      reader.read_event(evt);
+      while (!reader.failed()) {
+        writer.write_event(evt);
+        nevents++;
+        reader.read_event(evt);
+      }
+      writer.close();
+    } else {
+      std::vector<std::shared_ptr<HepMC3::GenRunInfo>> run_infos;
+      for (auto const &shard : shards) {
+        run_infos.push_back(NuHepMC::Merge::ReadRunInfo(shard));
+      }
+      std::vector<size_t> shard_nevents;
+      auto run_info =
+          NuHepMC::Merge::MergeRunInfo(shards, run_infos, shard_nevents);
+
+      std::ofstream os(outfile, std::ios::binary);
+      std::vector<char> iobuf(1 << 20);
+      os.rdbuf()->pubsetbuf(iobuf.data(), iobuf.size());
+      os << NuHepMC::FormatAsciiv3Header(run_info);
+
+      // Only the event number of each E line is rewritten, the rest of the
+      // event is copied byte for byte.
+      int evnum = first_evnum;
+      for (auto const &shard : shards) {
+        NuHepMC::MappedFile mapped(shard);
+        NuHepMC::AsciiEventScanner scanner(mapped.begin(), mapped.end());
+        NuHepMC::RawEvent raw;
+        while (scanner.Next(raw)) {
+          char const *rest = NuHepMC::Ascii::TokenEnd(
+              NuHepMC::Ascii::SkipBlanks(raw.begin + 1, raw.end), raw.end);
+          os << "E " << evnum++;
+          os.write(rest, raw.end - rest);
+          nevents++;
+        }
+      }
+      os << NuHepMC::kAsciiv3Footer;
+      if (!os) {
+        std::cout << "[ERROR]: Failed writing " << outfile << std::endl;
+        return 1;
+      }
+    }
+  } catch (NuHepMC::except &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::cout << "[INFO]: Merged " << nevents << " events from "
+            << shards.size() << " files into " << outfile << std::endl;
+  return 0;
+}
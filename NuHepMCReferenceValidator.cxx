@@ -1,8 +1,21 @@
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/CompressedStreams.hxx"
+#include "NuHepMC/EventIndex.hxx"
+#include "NuHepMC/EventNumberTracker.hxx"
+#include "NuHepMC/EventPipeline.hxx"
+#include "NuHepMC/Profiling.hxx"
 #include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/Validation.hxx"
+#include "NuHepMC/ValidationCheckpoint.hxx"
 
 #include "HepMC3/Print.h"
 #include "HepMC3/ReaderFactory.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -10,6 +23,8 @@
 NEW_NuHepMC_EXCEPT(RequirementException);
 NEW_NuHepMC_EXCEPT(ConventionException);
 
+NuHepMC_PROFILE_ALLOCATIONS()
+
 void Validate_GR1(std::shared_ptr<HepMC3::GenRunInfo> &run_info) {
   if (!run_info) {
     throw RequirementException() << "[FAILED]: G.R.1 Valid GenRunInfo";
@@ -56,29 +71,308 @@ void Validate_GR7(std::shared_ptr<HepMC3::GenRunInfo> &run_info) {
 
 bool DeclaredConvention(std::set<std::string> const &conventions,
                         std::string const &testconv) {
-  return std::find(conventions.begin(), conventions.end(), testconv) !=
-         conventions.end();
+  return conventions.count(testconv);
+}
+
+NuHepMC::EventIndex LoadIndex(std::string const &filename) {
+  auto sidecar = NuHepMC::EventIndex::GetSidecarName(filename);
+  if (std::ifstream(sidecar)) {
+    try {
+      auto index = NuHepMC::EventIndex::Read(sidecar);
+      std::string why;
+      if (index.IsValidFor(filename, &why)) {
+        std::cout << "[INFO]: Using event index " << sidecar << std::endl;
+        return index;
+      }
+      std::cout << "[WARN]: Ignoring stale event index " << sidecar << ": "
+                << why << std::endl;
+    } catch (NuHepMC::EventIndexException &e) {
+      std::cout << "[WARN]: Ignoring event index " << sidecar << ": "
+                << e.what() << std::endl;
+    }
+  }
+  std::cout << "[INFO]: Building event index for " << filename << std::endl;
+  auto index = NuHepMC::EventIndex::Build(filename);
+  try {
+    index.Write(sidecar);
+    std::cout << "[INFO]: Wrote event index " << sidecar << std::endl;
+  } catch (NuHepMC::EventIndexException &e) {
+    // e.g. a read-only directory, the index is still used for this run
+    std::cout << "[WARN]: " << e.what() << std::endl;
+  }
+  return index;
+}
+
+// Restores checkpoint from the sidecar of filename if it still describes the
+// file, otherwise starts it from the first event.
+void LoadCheckpoint(std::string const &filename,
+                    NuHepMC::MappedFile const &mapped,
+                    NuHepMC::AsciiEventScanner &scanner, uint32_t flags,
+                    NuHepMC::ValidationCheckpoint &checkpoint) {
+  auto sidecar = NuHepMC::ValidationCheckpoint::GetSidecarName(filename);
+  if (std::ifstream(sidecar)) {
+    try {
+      checkpoint.Read(sidecar);
+      std::string why;
+      if (!checkpoint.IsValidFor(mapped, scanner, flags, &why)) {
+        std::cout << "[WARN]: Ignoring checkpoint " << sidecar << ": " << why
+                  << ", validating from the first event." << std::endl;
+      } else if (!scanner.Seek(checkpoint.GetOffset())) {
+        std::cout << "[WARN]: Ignoring checkpoint " << sidecar
+                  << ": the validated events no longer end at an event "
+                     "boundary, validating from the first event."
+                  << std::endl;
+      } else {
+        std::cout << "[INFO]: Resuming from checkpoint " << sidecar
+                  << " after " << checkpoint.GetNEvents()
+                  << " validated events." << std::endl;
+        return;
+      }
+    } catch (NuHepMC::CheckpointException &e) {
+      std::cout << "[WARN]: Ignoring checkpoint " << sidecar << ": "
+                << e.what() << std::endl;
+    }
+  }
+  checkpoint.Reset(scanner, flags);
+}
+
+// The size of the text of an event, where it is known without re-reading it.
+size_t TextSize(NuHepMC::RawEvent const &evt) {
+  return size_t(evt.end - evt.begin);
+}
+size_t TextSize(HepMC3::GenEvent const &) { return 0; }
+
+// The size of the text read through reader: the number of bytes decompressed
+// for compressed input, otherwise the size of the file.
+uint64_t InputTextSize(HepMC3::Reader const &reader,
+                       std::string const &filename) {
+  if (auto compressed =
+          dynamic_cast<NuHepMC::CompressedReaderAscii const *>(&reader)) {
+    return compressed->GetNBytesRead();
+  }
+  return uint64_t(
+      std::ifstream(filename, std::ios::binary | std::ios::ate).tellg());
+}
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " [--threads N] [--index | --fast] [--collect-all] "
+         "[--max-failures N] [--report report.json] [--checkpoint] "
+         "[--checkpoint-every N] [--profile profile.json] [--progress S] "
+         "<file.hepmc3[.gz|.zst]>\n"
+      << "\t--threads N        : Validate events on N worker threads while "
+         "the\n\t                     file is read on the main thread.\n"
+      << "\t--index            : Use an event index to split an Asciiv3 "
+         "file\n\t                     into one range per thread, each read "
+         "in\n\t                     parallel. The index is read from\n"
+         "\t                     <file.hepmc3>.nuhepmcidx if it is up to "
+         "date,\n\t                     see NuHepMCIndexer, otherwise it is "
+         "built\n\t                     and written there.\n"
+      << "\t--fast             : Check events directly from the text of a "
+         "memory-\n\t                     mapped Asciiv3 file rather than "
+         "building\n\t                     a HepMC3::GenEvent for each one.\n"
+      << "\t--collect-all      : Continue past failures, counting them for "
+         "each\n\t                     rule, and write a JSON report at the "
+         "end.\n"
+      << "\t--max-failures N   : Number of failures to describe in the "
+         "report\n\t                     for each rule, defaults to 10.\n"
+      << "\t--report <file>    : Where to write the --collect-all report, "
+         "defaults\n\t                     to NuHepMCValidationReport.json.\n"
+      << "\t--checkpoint       : Only validate the events of an Asciiv3 file "
+         "that\n\t                     were not validated by an earlier run, "
+         "as\n\t                     recorded in <file.hepmc3>.nuhepmcckpt, "
+         "and\n\t                     update it. Without a footer, the last "
+         "event\n\t                     is left for a later run as it may "
+         "still be\n\t                     being written. A checkpoint "
+         "written with\n\t                     different --collect-all or "
+         "--max-failures\n\t                     options is ignored.\n"
+      << "\t--checkpoint-every N: Update the checkpoint after every N "
+         "events,\n\t                     defaults to 1000000.\n"
+      << "\t--profile <file>   : Write the time spent in each stage and "
+         "rule,\n\t                     and the event, byte and allocation "
+         "rates, to\n\t                     a JSON file. Needs a build with "
+         "\n\t                     NuHepMC_ENABLE_PROFILING.\n"
+      << "\t--progress S       : Print the number of events validated and "
+         "the\n\t                     rates every S seconds. Needs a build "
+         "with\n\t                     NuHepMC_ENABLE_PROFILING.\n"
+      << std::endl;
 }
 
 int main(int argc, char const *argv[]) {
-  auto reader = HepMC3::deduce_reader(argv[1]);
+  std::string filename;
+  size_t nthreads = 0;
+  bool use_index = false;
+  bool fast = false;
+  bool collect_all = false;
+  bool use_checkpoint = false;
+  size_t checkpoint_every = 1000000;
+  size_t max_failures = 10;
+  std::string report_file = "NuHepMCValidationReport.json";
+  std::string profile_file;
+  double progress_interval = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "--threads") && ((i + 1) < argc)) {
+      nthreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--index") {
+      use_index = true;
+    } else if (arg == "--fast") {
+      fast = true;
+    } else if (arg == "--collect-all") {
+      collect_all = true;
+    } else if ((arg == "--max-failures") && ((i + 1) < argc)) {
+      max_failures = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "--report") && ((i + 1) < argc)) {
+      report_file = argv[++i];
+    } else if (arg == "--checkpoint") {
+      use_checkpoint = true;
+    } else if ((arg == "--checkpoint-every") && ((i + 1) < argc)) {
+      checkpoint_every =
+          std::max(size_t(1), size_t(std::strtoul(argv[++i], nullptr, 10)));
+    } else if ((arg == "--profile") && ((i + 1) < argc)) {
+      profile_file = argv[++i];
+    } else if ((arg == "--progress") && ((i + 1) < argc)) {
+      progress_interval = std::atof(argv[++i]);
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else if (filename.empty()) {
+      filename = arg;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (filename.empty()) {
+    SayUsage(argv);
+    return 1;
+  }
+
+  if (use_index && fast) {
+    std::cout << "[ERROR]: --index and --fast cannot be combined." << std::endl;
+    return 1;
+  }
+  if (use_index && use_checkpoint) {
+    std::cout << "[ERROR]: --index and --checkpoint cannot be combined."
+              << std::endl;
+    return 1;
+  }
+
+  if (!NuHepMC::Profiling::kEnabled &&
+      (profile_file.size() || (progress_interval > 0))) {
+    std::cout << "[WARN]: --profile and --progress are ignored, this build "
+                 "does not define NuHepMC_ENABLE_PROFILING."
+              << std::endl;
+    profile_file.clear();
+    progress_interval = 0;
+  }
+  NuHepMC::Profiling::Session profile(profile_file, progress_interval,
+                                      "Validated");
+
+  // Compressed files are decompressed as they are read, the index, the
+  // fast path and checkpoints all need the text itself.
+  auto compression = NuHepMC::DetectCompression(filename);
+  if ((use_index || use_checkpoint) &&
+      (compression != NuHepMC::Compression::kNone)) {
+    std::cout << "[ERROR]: " << (use_index ? "--index" : "--checkpoint")
+              << " requires an uncompressed Asciiv3 file, " << filename
+              << " is " << NuHepMC::GetName(compression) << " compressed."
+              << std::endl;
+    return 1;
+  }
+
+  // The text is mapped up front so that a file that the fast path cannot
+  // handle is rejected before any checks are run.
+  std::unique_ptr<NuHepMC::MappedFile> mapped;
+  std::unique_ptr<NuHepMC::AsciiEventScanner> scanner;
+  if (fast || use_checkpoint) {
+    try {
+      mapped = std::make_unique<NuHepMC::MappedFile>(filename);
+      scanner = std::make_unique<NuHepMC::AsciiEventScanner>(mapped->begin(),
+                                                             mapped->end());
+    } catch (NuHepMC::AsciiScannerException &e) {
+      std::cout << "[ERROR]: " << (fast ? "--fast" : "--checkpoint")
+                << " requires an uncompressed Asciiv3 file: " << e.what()
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::shared_ptr<HepMC3::Reader> reader;
+  try {
+    reader = NuHepMC::OpenReader(filename);
+  } catch (NuHepMC::CompressionException &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
   if (!reader || reader->failed()) {
     return 1;
   }
 
+  NuHepMC::Validation::ValidationReport report(max_failures);
+  size_t nevents = 0;
+
+  auto WriteReport = [&]() {
+    std::ofstream os(report_file);
+    report.WriteJSON(os, filename, nevents);
+
+    std::cout << "[INFO]: Wrote validation report to " << report_file
+              << std::endl;
+    for (auto const &st : report.GetStats()) {
+      if (st.nfailed) {
+        std::cout << "[FAILED]: " << st.id << " failed " << st.nfailed << "/"
+                  << st.nchecked << " checks." << std::endl;
+      }
+    }
+    return report.GetNFailed() ? 1 : 0;
+  };
+
+  // In --collect-all mode the failure of a run-level rule is recorded and
+  // validation continues, otherwise it is fatal.
+  auto CheckRunRule = [&](std::string const &id,
+                          std::function<void()> const &check) {
+    auto &stats = report.GetStats(id);
+    try {
+      check();
+      report.Record(stats, true);
+      return true;
+    } catch (std::exception &e) {
+      if (!collect_all) {
+        throw;
+      }
+      report.Record(stats, false, NuHepMC::Validation::kNoEvent, 0,
+                    [&]() { return std::string(e.what()); });
+      return false;
+    }
+  };
+
   // Some readers
   HepMC3::GenEvent evt;
-  reader->read_event(evt);
+  try {
+    reader->read_event(evt);
+  } catch (NuHepMC::CompressionException &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
 
   auto run_info = reader->run_info();
-  Validate_GR1(run_info);
-  Validate_GR2(run_info);
-  Validate_GR3(run_info);
-
-  auto ProcessIds = NuHepMC::GenRunInfo::ReadProcessIDDefinitions(run_info);
-  if (!ProcessIds.size()) {
-    throw RequirementException() << "[FAILED]: G.R.4 Process Metadata";
+  if (!CheckRunRule("G.R.1", [&]() { Validate_GR1(run_info); })) {
+    // Nothing further can be checked without the run info.
+    return WriteReport();
   }
+  CheckRunRule("G.R.2", [&]() { Validate_GR2(run_info); });
+  CheckRunRule("G.R.3", [&]() { Validate_GR3(run_info); });
+
+  NuHepMC::StatusCodeDescriptors ProcessIds;
+  CheckRunRule("G.R.4", [&]() {
+    ProcessIds = NuHepMC::GenRunInfo::ReadProcessIDDefinitions(run_info);
+    if (!ProcessIds.size()) {
+      throw RequirementException() << "[FAILED]: G.R.4 Process Metadata";
+    }
+  });
 
   std::cout << "Declared Process Identifiers: " << std::endl;
   for (auto &proc_descriptor : ProcessIds) {
@@ -87,8 +381,11 @@ int main(int argc, char const *argv[]) {
               << proc_descriptor.second.second << std::endl;
   }
 
-  auto VertexStatuses =
-      NuHepMC::GenRunInfo::ReadVertexStatusIDDefinitions(run_info);
+  NuHepMC::StatusCodeDescriptors VertexStatuses;
+  CheckRunRule("G.R.5", [&]() {
+    VertexStatuses =
+        NuHepMC::GenRunInfo::ReadVertexStatusIDDefinitions(run_info);
+  });
   std::cout << "Declared Vertex Status Codes: " << std::endl;
   for (auto &vertex_status_descriptor : VertexStatuses) {
     std::cout << "\t" << vertex_status_descriptor.first << ": "
@@ -96,8 +393,11 @@ int main(int argc, char const *argv[]) {
               << vertex_status_descriptor.second.second << std::endl;
   }
 
-  auto ParticleStatuses =
-      NuHepMC::GenRunInfo::ReadParticleStatusIDDefinitions(run_info);
+  NuHepMC::StatusCodeDescriptors ParticleStatuses;
+  CheckRunRule("G.R.6", [&]() {
+    ParticleStatuses =
+        NuHepMC::GenRunInfo::ReadParticleStatusIDDefinitions(run_info);
+  });
   std::cout << "Declared Particle Status Codes: " << std::endl;
   for (auto &particle_status_descriptor : ParticleStatuses) {
     std::cout << "\t" << particle_status_descriptor.first << ": "
@@ -105,7 +405,7 @@ int main(int argc, char const *argv[]) {
               << particle_status_descriptor.second.second << std::endl;
   }
 
-  Validate_GR7(run_info);
+  CheckRunRule("G.R.7", [&]() { Validate_GR7(run_info); });
 
   auto Conventions = NuHepMC::GenRunInfo::ReadConventions(run_info);
   std::cout << "Reportedly following conventions: " << std::endl;
@@ -114,33 +414,39 @@ int main(int argc, char const *argv[]) {
   }
 
   if (DeclaredConvention(Conventions, "G.C.2")) {
-    auto NEvents = NuHepMC::CheckedAttributeValue<HepMC3::LongAttribute>(
-        run_info, "NuHepMC.Exposure.NEvents", -1);
-    if (NEvents == -1) {
-      throw ConventionException()
-          << "[FAILED] G.C.2 File Exposure (Standalone)";
-    }
+    CheckRunRule("G.C.2", [&]() {
+      auto NEvents = NuHepMC::CheckedAttributeValue<HepMC3::LongAttribute>(
+          run_info, "NuHepMC.Exposure.NEvents", -1);
+      if (NEvents == -1) {
+        throw ConventionException()
+            << "[FAILED] G.C.2 File Exposure (Standalone)";
+      }
+    });
   }
 
   if (DeclaredConvention(Conventions, "G.C.3")) {
-    auto POT = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
-        run_info, "NuHepMC.Exposure.POT", -1);
-    auto Livetime = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
-        run_info, "NuHepMC.Exposure.Livetime", -1);
-
-    if ((POT == -1) && (Livetime == -1)) {
-      throw ConventionException()
-          << "[FAILED] G.C.3 File Exposure (Experimental)";
-    }
+    CheckRunRule("G.C.3", [&]() {
+      auto POT = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
+          run_info, "NuHepMC.Exposure.POT", -1);
+      auto Livetime = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
+          run_info, "NuHepMC.Exposure.Livetime", -1);
+
+      if ((POT == -1) && (Livetime == -1)) {
+        throw ConventionException()
+            << "[FAILED] G.C.3 File Exposure (Experimental)";
+      }
+    });
   }
 
   if (DeclaredConvention(Conventions, "G.C.4")) {
-    auto fatx = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
-        run_info, "NuHepMC.FluxAveragedTotalCrossSection", -1);
-    if (fatx == -1) {
-      throw ConventionException()
-          << "[FAILED] G.C.4 Flux-averaged Total Cross Section";
-    }
+    CheckRunRule("G.C.4", [&]() {
+      auto fatx = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
+          run_info, "NuHepMC.FluxAveragedTotalCrossSection", -1);
+      if (fatx == -1) {
+        throw ConventionException()
+            << "[FAILED] G.C.4 Flux-averaged Total Cross Section";
+      }
+    });
   }
 
   if (!DeclaredConvention(Conventions, "G.C.5")) {
@@ -151,150 +457,223 @@ int main(int argc, char const *argv[]) {
               << std::endl;
   }
 
-  std::set<int> event_numbers;
-  while (!reader->failed()) {
-    // check event
-    auto evnum = evt.event_number();
-    if (event_numbers.count(evnum)) {
-      throw RequirementException()
-          << "Event number " << std::to_string(evnum)
-          << " is not unique within this file.\n[FAILED] Event " << evnum
-          << " -- E.R.1 Event Number";
-    }
-    if (evnum < 0) {
-      throw RequirementException() << "Event number " << std::to_string(evnum)
-                                   << " is negative.\n[FAILED] Event " << evnum
-                                   << " -- E.R.1 Event Number";
-    }
-    event_numbers.insert(evnum);
+  NuHepMC::EventPipeline pipeline(nthreads);
 
-    try {
-      auto ProcID =
-          NuHepMC::CheckedAttributeValue<HepMC3::IntAttribute>(&evt, "ProcID");
-      if (!ProcessIds.count(ProcID)) {
-        RequirementException()
-            << "Process " << ProcID << " was not declared.\n[FAILED] Event "
-            << evnum << " -- E.R.2 Process ID";
-      }
-    } catch (std::exception &e) {
-      throw RequirementException() << "Subexception: (\n"
-                                   << e.what() << " ).\n[FAILED] Event "
-                                   << evnum << " -- E.R.2 Process ID";
+  // With an index the file is instead split into one range of whole events
+  // per thread, each read by its own reader.
+  std::unique_ptr<NuHepMC::EventIndex> index;
+  if (use_index) {
+    index = std::make_unique<NuHepMC::EventIndex>(LoadIndex(filename));
+  }
+  size_t nslots = index ? std::max(nthreads, size_t(1)) : pipeline.GetNSlots();
+
+  // The results of the event-level rules are kept apart from those of the
+  // run-level rules, which are checked afresh on every run, so that they can
+  // be saved to and restored from a checkpoint.
+  NuHepMC::ValidationCheckpoint checkpoint(max_failures);
+  uint32_t const checkpoint_flags =
+      collect_all ? uint32_t(NuHepMC::ValidationCheckpoint::kCollectAll) : 0u;
+  if (use_checkpoint) {
+    LoadCheckpoint(filename, *mapped, *scanner, checkpoint_flags, checkpoint);
+  }
+  auto &events_report = checkpoint.GetReport();
+
+  // E.R.1 carries state between events and so is checked in file order,
+  // either on the reading thread or from the index.
+  NuHepMC::EventNumberTracker &event_numbers = checkpoint.GetEventNumbers();
+  auto &ER1Stats = events_report.GetStats("E.R.1");
+  auto CheckEventNumber = [&](int evnum, size_t seq) {
+    NuHepMC_PROFILE_SCOPE("Rule.E.R.1");
+    bool unique = event_numbers.Insert(evnum);
+    bool positive = (evnum >= 0);
+
+    auto Describe = [&]() {
+      std::stringstream ss;
+      ss << "Event number " << std::to_string(evnum)
+         << (unique ? " is negative" : " is not unique within this file")
+         << ".\n[FAILED] Event " << evnum << " -- E.R.1 Event Number";
+      return ss.str();
+    };
+
+    if (!collect_all && (!unique || !positive)) {
+      throw RequirementException() << Describe();
     }
+    events_report.Record(ER1Stats, unique && positive, seq, evnum, Describe);
+  };
+  auto ValidateEventNumber = [&](HepMC3::GenEvent const &evt, size_t seq,
+                                 size_t) {
+    CheckEventNumber(evt.event_number(), seq);
+  };
+
+  // The remaining checks only look at the event itself and the (read-only)
+  // run-level definitions, so they may be run on worker threads. The set of
+  // rules to check is resolved once here from the declared conventions.
+  NuHepMC::Validation::ValidationPlan plan(
+      Conventions, {ProcessIds, VertexStatuses, ParticleStatuses});
+
+  std::vector<NuHepMC::Validation::EventFields> slot_fields(nslots);
+  std::vector<NuHepMC::Validation::ValidationReport> slot_reports;
+  for (size_t i = 0; i < nslots; ++i) {
+    slot_reports.emplace_back(max_failures);
+  }
 
-    try {
-      auto LabPos =
-          NuHepMC::CheckedAttributeValue<HepMC3::VectorDoubleAttribute>(
-              &evt, "LabPos");
-    } catch (std::exception &e) {
-      throw RequirementException() << "Subexception: (\n"
-                                   << e.what() << " ).\n[FAILED] Event "
-                                   << evnum << " -- E.R.4 Lab Position";
-    }
+  // evt is either a HepMC3::GenEvent or, with --fast, a NuHepMC::RawEvent.
+  auto ValidateEvent = [&](auto const &evt, size_t seq, size_t slot) {
+    NuHepMC_PROFILE_EVENTS(1, TextSize(evt));
+    auto &fields = slot_fields[slot];
+    NuHepMC::Validation::FillEventFields(evt, plan.GetNeeds(), fields);
 
-    int nprimvtx = 0;
-    for (auto const &vtx : evt.vertices()) {
-      if (vtx->status() == NuHepMC::VertexStatus::kPrimaryVertex) {
-        nprimvtx++;
-      }
-      if (vtx->status() == 0) {
-        throw RequirementException()
-            << "Found vertex with status == 0.\n[FAILED] Event " << evnum
-            << " -- E.R.5 Vertices";
-      }
+    if (collect_all) {
+      slot_reports[slot].CheckEvent(plan, fields, seq);
+      return;
     }
 
-    if (nprimvtx != 1) {
-      throw RequirementException()
-          << "Found " << nprimvtx << " Primary vertices.\n[FAILED] Event "
-          << evnum << " -- E.R.5 Vertices";
+    auto failed_rule = plan.Check(fields);
+    if (!failed_rule) {
+      return;
     }
 
-    if (evt.beams().size() < 1) {
-      throw RequirementException()
-          << "Event contained no beam particles.\n[FAILED] Event " << evnum
-          << " -- E.R.6 Beam "
-             "Particle";
+    if (failed_rule->is_convention) {
+      throw ConventionException() << plan.Describe(*failed_rule, fields);
     }
-
-    if (DeclaredConvention(Conventions, "E.C.2")) {
-      auto TotXS = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
-          &evt, "TotXS");
-
-      if (TotXS == -1) {
-        throw ConventionException()
-            << "[FAILED] Event " << evnum << " -- E.C.2 Total Cross Section";
+    throw RequirementException() << plan.Describe(*failed_rule, fields);
+  };
+
+  if (use_checkpoint) {
+    // Only the events after those validated by earlier runs are read, in
+    // chunks, after each of which the checkpoint is updated so that an
+    // interrupted run can be resumed.
+    auto sidecar = NuHepMC::ValidationCheckpoint::GetSidecarName(filename);
+    char const *file_begin = mapped->begin();
+    size_t const nresumed = checkpoint.GetNEvents();
+    size_t first_seq = nresumed;
+    bool incomplete = false;
+
+    std::vector<NuHepMC::RawEvent> chunk;
+    NuHepMC::RawEvent next;
+    bool has_next = scanner->Next(next);
+    while (has_next) {
+      chunk.clear();
+      while (has_next && (chunk.size() < checkpoint_every)) {
+        chunk.push_back(next);
+        has_next = scanner->Next(next);
+      }
+      if (!has_next && !scanner->AtFooter()) {
+        // Without a footer the file may still be being written, so the
+        // last event may be incomplete.
+        chunk.pop_back();
+        incomplete = true;
+      }
+      if (chunk.empty()) {
+        break;
       }
-    }
-
-    if (DeclaredConvention(Conventions, "E.C.3")) {
-      auto ProcXS = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
-          &evt, "ProcXS", -1);
 
-      if (ProcXS == -1) {
-        throw ConventionException()
-            << "[FAILED] Event " << evnum << " -- E.C.3 Process Cross Section";
+      if (fast) {
+        size_t i = 0;
+        pipeline.RunSource<NuHepMC::RawEvent>(
+            [&](NuHepMC::RawEvent &raw) {
+              if (i == chunk.size()) {
+                return false;
+              }
+              raw = chunk[i++];
+              return true;
+            },
+            [&](NuHepMC::RawEvent const &raw, size_t seq, size_t) {
+              CheckEventNumber(raw.evnum, first_seq + seq);
+            },
+            [&](NuHepMC::RawEvent const &raw, size_t seq, size_t slot) {
+              ValidateEvent(raw, first_seq + seq, slot);
+            });
+      } else {
+        NuHepMC_PROFILE_EVENTS(0, chunk.back().end - chunk.front().begin);
+        NuHepMC::RangeReader range(filename, checkpoint.GetHeaderEnd(),
+                                   uint64_t(chunk.front().begin - file_begin),
+                                   uint64_t(chunk.back().end - file_begin));
+        HepMC3::GenEvent chunk_evt;
+        range.GetReader().read_event(chunk_evt);
+        pipeline.Run(
+            range.GetReader(), chunk_evt,
+            [&](HepMC3::GenEvent const &evt, size_t seq, size_t slot) {
+              ValidateEventNumber(evt, first_seq + seq, slot);
+            },
+            [&](HepMC3::GenEvent const &evt, size_t seq, size_t slot) {
+              ValidateEvent(evt, first_seq + seq, slot);
+            });
       }
-    }
 
-    if (DeclaredConvention(Conventions, "E.C.4")) {
-      if (!evt.cross_section()) {
-        throw ConventionException() << "[FAILED] Event " << evnum
-                                    << " -- E.C.4 Estimated Cross Section";
+      for (auto &slot_report : slot_reports) {
+        events_report.Merge(slot_report);
+        slot_report = NuHepMC::Validation::ValidationReport(max_failures);
       }
+      first_seq += chunk.size();
+      checkpoint.Advance(file_begin, chunk.back(), chunk.size());
+      checkpoint.Write(sidecar);
     }
 
-    if (DeclaredConvention(Conventions, "E.C.6")) {
-      auto LabPosTime =
-          NuHepMC::CheckedAttributeValue<HepMC3::VectorDoubleAttribute>(
-              &evt, "LabPos");
-
-      if (LabPosTime.size() != 4) {
-        throw ConventionException() << "[FAILED] Event " << evnum
-                                    << " -- E.C.6 Estimated Cross Section";
+    std::cout << "[INFO]: Validated " << (first_seq - nresumed)
+              << " new events after the " << nresumed
+              << " validated by earlier runs." << std::endl;
+    if (incomplete) {
+      std::cout << "[INFO]: " << filename
+                << " has no footer, its last event will be validated by a "
+                   "later run."
+              << std::endl;
+    }
+    nevents = first_seq;
+  } else if (index) {
+    // Only events before the first E.R.1 failure need to be read, a failure
+    // of any other rule in those events would be reported first.
+    size_t nvalidate = index->NEvents();
+    std::exception_ptr ER1Failure;
+    for (size_t i = 0; i < index->NEvents(); ++i) {
+      try {
+        CheckEventNumber((*index)[i].evnum, i);
+      } catch (...) {
+        ER1Failure = std::current_exception();
+        nvalidate = i;
+        break;
       }
     }
 
-    for (auto const &vtx : evt.vertices()) {
-      if (vtx->status() != NuHepMC::VertexStatus::kPrimaryVertex) {
-        if (!VertexStatuses.count(vtx->status())) {
-          throw RequirementException()
-              << "Vertex status " << vtx->status()
-              << " was not declared in the GenRunInfo.\n[FAILED] Event "
-              << evnum << " -- V.R.1 Vertex Status Codes";
-        }
-      }
+    std::vector<std::unique_ptr<NuHepMC::RangeReader>> range_readers;
+    std::vector<HepMC3::Reader *> readers;
+    std::vector<size_t> first_seq;
+    for (auto const &range : index->Split(nslots, nvalidate)) {
+      range_readers.push_back(std::make_unique<NuHepMC::RangeReader>(
+          filename, *index, range.first, range.second));
+      readers.push_back(&range_readers.back()->GetReader());
+      first_seq.push_back(range.first);
     }
 
-    for (auto const &part : evt.particles()) {
-      if (part->status() >= 20) {
-        if (!ParticleStatuses.count(part->status())) {
-          throw RequirementException()
-              << "Particle status " << part->status()
-              << " was not declared in the GenRunInfo but was used in "
-                 "event.\n[FAILED] Event "
-              << evnum << " -- P.R.1 Particle Status Codes";
-        }
-      } else if (part->status() > 11) {
-        throw RequirementException()
-            << "Particle status " << part->status()
-            << " is reserved but unused. " << evnum
-            << "\n[FAILED] P.R.1 Particle Status Codes";
-
-      } else if (part->status() < 1) {
-        throw RequirementException()
-            << "Particle status " << part->status()
-            << " is invalid is event.\n[FAILED] Event " << evnum
-            << " -- P.R.1 Particle Status Codes";
-      }
+    nevents = pipeline.RunShards(readers, first_seq, ValidateEvent);
+    if (ER1Failure) {
+      std::rethrow_exception(ER1Failure);
     }
+  } else if (scanner) {
+    nevents = pipeline.RunSource<NuHepMC::RawEvent>(
+        [&](NuHepMC::RawEvent &raw) { return scanner->Next(raw); },
+        [&](NuHepMC::RawEvent const &raw, size_t seq, size_t) {
+          CheckEventNumber(raw.evnum, seq);
+        },
+        ValidateEvent);
+  } else {
+    nevents = pipeline.Run(*reader, evt, ValidateEventNumber, ValidateEvent);
+  }
 
-    // try and read the next one
-    reader->read_event(evt);
+  std::cout << "[INFO]: Read " << nevents << " events." << std::endl;
+  if (NuHepMC::Profiling::kEnabled && !use_checkpoint && !scanner) {
+    // The events were read through a HepMC3 reader, so only the total is
+    // known.
+    NuHepMC_PROFILE_EVENTS(0, InputTextSize(*reader, filename));
   }
 
-  std::cout << "[INFO]: Read " << event_numbers.size() << " events."
-            << std::endl;
+  for (auto const &slot_report : slot_reports) {
+    events_report.Merge(slot_report);
+  }
+  report.Merge(events_report);
+  if (collect_all) {
+    return WriteReport();
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -7,187 +7,188 @@
 
 #include "HepMC3/WriterAscii.h"
 
+#include "NuHepMC/CompressedStreams.hxx"
+#include "NuHepMC/EventBuilder.hxx"
+#include "NuHepMC/Profiling.hxx"
+#include "NuHepMC/ReferenceEvents.hxx"
 #include "NuHepMC/WriterUtils.hxx"
 
-// E.C.4
-const double cm2_to_pb = 1E36;
-
-namespace NuHepMC {
-namespace VertexStatus {
-const int kFSIAbs = 2;
-}
-namespace ParticleStatus {
-const int kFSIState = 21;
-}
-} // namespace NuHepMC
-
-std::shared_ptr<HepMC3::GenRunInfo> BuildGenRunInfo() {
-  // G.R.1
-  std::shared_ptr<HepMC3::GenRunInfo> run_info =
-      std::make_shared<HepMC3::GenRunInfo>();
-
-  // G.R.1
-  NuHepMC::GenRunInfo::WriteNuHepMCVersion(run_info);
-
-  // G.R.3
-  run_info->tools().emplace_back(
-      HepMC3::GenRunInfo::ToolInfo{"MyGen", "0.0.1", "My Favorite Generator"});
-
-  // G.R.4
-  std::map<int, std::pair<std::string, std::string>> ProcessIDs = {
-      {200, {"CCQE", "The Moon QE Model -- PRD 1234 (1990)"}}, // G.C.5
-      {250, {"NCQE", "The Moon QE Model -- PRD 1234 (1990)"}}, // G.C.5
-      {300, {"MEC", "My Shiny MEC Model -- PRL 1 (1950)"}},    // G.C.5
-      {500, {"Single PiPlus Production", "PiPlus 2049"}},
-      {600, {"DIS", "Badabing Badaboom"}},
-  };
-  NuHepMC::GenRunInfo::WriteProcessIDDefinitions(run_info, ProcessIDs);
-
-  // G.R.5
-  std::map<int, std::pair<std::string, std::string>> VertexStatuses = {
-      {NuHepMC::VertexStatus::kPrimaryVertex,
-       {"PrimVer", "The primary vertex or hard scatter"}},
-      {NuHepMC::VertexStatus::kFSIAbs,
-       {"FSIAbs", "Final state absorption interaction"}},
-  };
-  NuHepMC::GenRunInfo::WriteVertexStatusIDDefinitions(run_info, VertexStatuses);
-
-  // G.R.6
-  std::map<int, std::pair<std::string, std::string>> ParticleStatuses = {
-      {NuHepMC::ParticleStatus::kUndecayedPhysicalParticle,
-       {"FinalState", "Undecayed physical particle"}},
-      {NuHepMC::ParticleStatus::kIncomingBeamParticle,
-       {"InitialState", "Incoming beam particle"}},
-      {NuHepMC::ParticleStatus::kFSIState,
-       {"FSI", "Final state interaction steps"}},
-  };
-  NuHepMC::GenRunInfo::WriteParticleStatusIDDefinitions(run_info,
-                                                        ParticleStatuses);
-
-  // G.R.7
-  run_info->set_weight_names({
-      "CV",
-  });
-
-  // G.C.1
-  run_info->add_attribute(
-      "NuHepMC.Conventions",
-      std::make_shared<HepMC3::VectorStringAttribute>(
-          std::vector<std::string>{"G.C.1", "G.C.2", "G.C.4", "G.C.5", "E.C.1",
-                                   "E.C.2", "E.C.3", "E.C.5", "E.C.6"}));
-
-  // G.C.2
-  run_info->add_attribute("NuHepMC.Exposure.NEvents",
-                          std::make_shared<HepMC3::IntAttribute>(3));
-
-  // G.C.4
-  run_info->add_attribute(
-      "NuHepMC.FluxAveragedTotalCrossSection",
-      std::make_shared<HepMC3::DoubleAttribute>(1.234E-38 * cm2_to_pb));
-
-  return run_info;
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+NuHepMC_PROFILE_ALLOCATIONS()
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " [-o example.hepmc3[.gz|.zst]] [--compression-level L] "
+         "[--compression-threads N] [--failing-events] "
+         "[--profile profile.json] [--progress S]\n"
+      << "\t-o <file>                : Where to write the events, defaults to\n"
+         "\t                           example.hepmc3. A .gz or .zst "
+         "extension\n\t                           compresses the output.\n"
+      << "\t--compression-level L    : gzip (1-9) or zstd (1-22) level, "
+         "defaults\n\t                           to 6 and 3 respectively.\n"
+      << "\t--compression-threads N  : Threads that compress blocks of the "
+         "output,\n\t                           defaults to the number of "
+         "cores.\n"
+      << "\t--failing-events         : After the reference events, write "
+         "events that\n\t                           each break one "
+         "requirement, for testing tools\n\t                           "
+         "that validate or convert files.\n"
+      << "\t--profile <file>         : Write the time spent in each stage, "
+         "and the\n\t                           event, byte and allocation "
+         "rates, to a JSON\n\t                           file. Needs a build "
+         "with\n\t                           NuHepMC_ENABLE_PROFILING.\n"
+      << "\t--progress S             : Print the number of events written "
+         "and the\n\t                           rates every S seconds. Needs "
+         "a build with\n\t                           "
+         "NuHepMC_ENABLE_PROFILING.\n"
+      << std::endl;
 }
 
-HepMC3::GenEvent BuildEvent(std::shared_ptr<HepMC3::GenRunInfo> &run_info) {
-  // E.R.3
-  HepMC3::GenEvent evt(run_info, HepMC3::Units::MEV, HepMC3::Units::MM);
-  // E.C.1
-  evt.weight("CV") = 1;
-
-  // E.C.2
-  evt.add_attribute(
-      "TotXS", std::make_shared<HepMC3::DoubleAttribute>(1.2E-36 * cm2_to_pb));
-  // E.C.3
-  evt.add_attribute(
-      "ProcXS", std::make_shared<HepMC3::DoubleAttribute>(0.8E-36 * cm2_to_pb));
-
-  // E.C.5
-  double etime_s = 0;
-  // E.R.4
-  evt.add_attribute("LabPos", std::make_shared<HepMC3::VectorDoubleAttribute>(
-                                  std::vector<double>{0, 0, 0, etime_s}));
-
-  HepMC3::GenParticlePtr ISNeutron = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{1.5255172492130473e+02, 8.9392830847276528e+01,
-                         6.4870597568257821e+01, 9.5825554558124941e+02},
-      2112, NuHepMC::ParticleStatus::kTargetParticle);
-  // E.R.6
-  HepMC3::GenParticlePtr ISnumu = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{0.0000000000000000e+00, 0.0000000000000000e+00,
-                         1.5000000000000000e+03, 1.5000000000000000e+03},
-      14, NuHepMC::ParticleStatus::kIncomingBeamParticle);
-  HepMC3::GenParticlePtr FSmuon = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{-6.8928697531845643e+01, 4.8219068401438176e+02,
-                         1.2406574501351240e+03, 1.3370316161682497e+03},
-      13, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle);
-  HepMC3::GenParticlePtr FSProton = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
-                         3.2421314743313258e+02, 1.0903266675337304e+03},
-      2212, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle);
-  HepMC3::GenParticlePtr FSIPiPlus = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
-                         3.2421314743313258e+02, 1.0903266675337304e+03},
-      211, NuHepMC::ParticleStatus::kFSIState);
-
-  ISNeutron->set_generated_mass(9.3956499999999994e+02);
-  ISnumu->set_generated_mass(0.0000000000000000e+00);
-  FSmuon->set_generated_mass(1.0565800000000023e+02);
-  FSProton->set_generated_mass(9.3827200000000005e+02);
-  FSIPiPlus->set_generated_mass(1.3957039000000000e+02);
-
-  HepMC3::GenVertexPtr primvertex =
-      std::make_shared<HepMC3::GenVertex>(HepMC3::FourVector{});
-  // E.R.5
-  primvertex->set_status(NuHepMC::VertexStatus::kPrimaryVertex);
-
-  primvertex->add_particle_in(ISNeutron);
-  primvertex->add_particle_in(ISnumu);
-  primvertex->add_particle_out(FSmuon);
-  primvertex->add_particle_out(FSProton);
-  primvertex->add_particle_out(FSIPiPlus);
-
-  evt.add_vertex(primvertex);
-
-  HepMC3::GenParticlePtr FSProton2 = std::make_shared<HepMC3::GenParticle>(
-      HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
-                         3.2421314743313258e+02, 1.0903266675337304e+03},
-      2212, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle);
-  FSProton2->set_generated_mass(9.3827200000000005e+02);
-
-  HepMC3::GenVertexPtr fsivertex = std::make_shared<HepMC3::GenVertex>(
-      HepMC3::FourVector{1E-10, 2E-10, 3E-10, 4E-10});
-  // V.R.1
-  fsivertex->set_status(NuHepMC::VertexStatus::kFSIAbs);
-
-  fsivertex->add_particle_in(FSIPiPlus);
-  fsivertex->add_particle_out(FSProton2);
-
-  evt.add_vertex(fsivertex);
-
-  return evt;
+int main(int argc, char const *argv[]) {
+  std::string outfile = "example.hepmc3";
+  int level = NuHepMC::kDefaultCompressionLevel;
+  size_t nthreads = std::thread::hardware_concurrency();
+  std::string profile_file;
+  double progress_interval = 0;
+  bool failing_events = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-o") && ((i + 1) < argc)) {
+      outfile = argv[++i];
+    } else if ((arg == "--compression-level") && ((i + 1) < argc)) {
+      level = std::atoi(argv[++i]);
+    } else if ((arg == "--compression-threads") && ((i + 1) < argc)) {
+      nthreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--failing-events") {
+      failing_events = true;
+    } else if ((arg == "--profile") && ((i + 1) < argc)) {
+      profile_file = argv[++i];
+    } else if ((arg == "--progress") && ((i + 1) < argc)) {
+      progress_interval = std::atof(argv[++i]);
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (!NuHepMC::Profiling::kEnabled &&
+      (profile_file.size() || (progress_interval > 0))) {
+    std::cout << "[WARN]: --profile and --progress are ignored, this build "
+                 "does not define NuHepMC_ENABLE_PROFILING."
+              << std::endl;
+    profile_file.clear();
+    progress_interval = 0;
+  }
+  NuHepMC::Profiling::Session profile(profile_file, progress_interval,
+                                      "Written");
+
+  // Each is a reference event with one defect. HepMC3 reads a non-numeric
+  // ProcXS as 0, so only a validator that reads the event text fails that
+  // one.
+  using Defect =
+      std::function<void(NuHepMC::EventBuilder const &, HepMC3::GenEvent &)>;
+  std::vector<Defect> Defects;
+  if (failing_events) {
+    Defects = {
+        // E.R.2
+        [](NuHepMC::EventBuilder const &builder, HepMC3::GenEvent &evt) {
+          builder.SetProcID(evt, 999);
+        },
+        // E.C.2
+        [](NuHepMC::EventBuilder const &, HepMC3::GenEvent &evt) {
+          evt.remove_attribute("TotXS");
+        },
+        // E.C.3
+        [](NuHepMC::EventBuilder const &, HepMC3::GenEvent &evt) {
+          evt.add_attribute(
+              "ProcXS", std::make_shared<HepMC3::StringAttribute>("high"));
+        },
+        [](NuHepMC::EventBuilder const &builder, HepMC3::GenEvent &evt) {
+          builder.SetProcXS(evt, -1);
+        },
+        // V.R.1
+        [](NuHepMC::EventBuilder const &, HepMC3::GenEvent &evt) {
+          evt.vertices().back()->set_status(7);
+        },
+        // P.R.1
+        [](NuHepMC::EventBuilder const &, HepMC3::GenEvent &evt) {
+          evt.particles().back()->set_status(15);
+        },
+    };
+  }
+
+  std::vector<std::pair<int, int>> const EventNumberProcIDs = {
+      {1, 200}, {2, 300}, {3, 500}};
+
+  auto run_info = NuHepMC::Reference::BuildGenRunInfo(
+      NuHepMC::Reference::ProcessIDs(), {"CV"},
+      int(EventNumberProcIDs.size() + Defects.size()));
+
+  // Particles, vertices and attributes are allocated from a pool that is
+  // reused from one event to the next.
+  NuHepMC::EventBuilder builder(run_info);
+
+  std::shared_ptr<HepMC3::Writer> output;
+  try {
+    output = NuHepMC::OpenWriterAscii(outfile, run_info, level, nthreads);
+  } catch (NuHepMC::CompressionException &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  // Events are written on a background thread while the next ones are built.
+  NuHepMC::AsyncWriter writer(output);
+
+  for (auto const &evnum_procid : EventNumberProcIDs) {
+    auto evt = writer.GetEvent();
+    {
+      NuHepMC_PROFILE_SCOPE("Writer.BuildEvent");
+      NuHepMC::Reference::BuildEvent(builder, *evt);
+    }
+    // E.R.1
+    evt->set_event_number(evnum_procid.first);
+    // E.R.2
+    builder.SetProcID(*evt, evnum_procid.second);
+    writer.Write(std::move(evt));
+    NuHepMC_PROFILE_EVENTS(1, 0);
+  }
+
+  int evnum = int(EventNumberProcIDs.size());
+  for (auto const &AddDefect : Defects) {
+    auto evt = writer.GetEvent();
+    NuHepMC::Reference::BuildEvent(builder, *evt);
+    evt->set_event_number(++evnum);
+    builder.SetProcID(*evt, 200);
+    AddDefect(builder, *evt);
+    writer.Write(std::move(evt));
+    NuHepMC_PROFILE_EVENTS(1, 0);
+  }
+
+  try {
+    writer.Close();
+  } catch (std::exception &e) {
+    std::cout << "[ERROR]: Failed writing " << outfile << ": " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  if (NuHepMC::Profiling::kEnabled) {
+    // Events are written through a HepMC3 writer, so only the size of the
+    // whole file is known.
+    NuHepMC_PROFILE_EVENTS(
+        0, std::ifstream(outfile, std::ios::binary | std::ios::ate).tellg());
+  }
 }
-
-int main() {
-
-  auto run_info = BuildGenRunInfo();
-
-  auto writer =
-      std::make_shared<HepMC3::WriterAscii>("example.hepmc3", run_info);
-
-  auto evt = BuildEvent(run_info);
-  evt.set_event_number(1);
-  // E.R.2
-  evt.add_attribute("ProcID", std::make_shared<HepMC3::IntAttribute>(200));
-  // E.R.1
-  writer->write_event(evt);
-
-  evt.set_event_number(2);
-  evt.add_attribute("ProcID", std::make_shared<HepMC3::IntAttribute>(300));
-  writer->write_event(evt);
-
-  evt.set_event_number(3);
-  evt.add_attribute("ProcID", std::make_shared<HepMC3::IntAttribute>(500));
-  writer->write_event(evt);
-
-  writer->close();
-}
\ No newline at end of file
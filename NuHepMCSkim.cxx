@@ -0,0 +1,272 @@
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/CompressedStreams.hxx"
+#include "NuHepMC/EventPipeline.hxx"
+#include "NuHepMC/Merge.hxx"
+#include "NuHepMC/Skim.hxx"
+#include "NuHepMC/WriterUtils.hxx"
+
+#include "HepMC3/GenEvent.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " -o <skimmed.hepmc3[.gz|.zst]> [--threads N] <selection> "
+         "<file.hepmc3[.gz|.zst]>\n"
+      << "\t-o <file>          : The skimmed output file, compressed "
+         "according to\n\t                     its extension.\n"
+      << "\t--threads N        : Evaluate the selection on N worker threads.\n"
+      << "\n\tThe selection combines comparisons of the event variables "
+         "ProcID,\n\tevnum, TotXS, ProcXS and LabPos[0-3] with &&, || and !, "
+         "for example:\n"
+         "\t  'ProcID in {200, 300} && any(pdg == 211 && status == 1)'\n"
+         "\t  'count(abspdg == 211 && status == 1) >= 2'\n"
+         "\tany(...) and count(...) range over the particles of the event,\n"
+         "\twith the variables pdg, abspdg, status, px, py, pz, e and mass.\n"
+         "\tThe operators are ==, !=, <, <=, >, >= and in {a, b, ...}.\n"
+      << "\n\tEvents are selected from their text, without building a "
+         "HepMC3::GenEvent,\n\tand copied verbatim when the input is an "
+         "uncompressed Asciiv3 file.\n\tThe output run info has "
+         "NuHepMC.Exposure.NEvents set to the number\n\tof selected events "
+         "and NuHepMC.FluxAveragedTotalCrossSection scaled by\n\tthe "
+         "fraction selected, so that cross sections estimated from the\n\t"
+         "weights of the selected events are unchanged.\n"
+      << std::endl;
+}
+
+// Selects events directly from the text of a memory-mapped Asciiv3 file and
+// copies the selected ones through byte for byte. Events are scanned in
+// chunks, the selection is evaluated on the events of each chunk in
+// parallel, and runs of consecutive selected events are copied as a single
+// range.
+size_t SkimAsciiv3(NuHepMC::MappedFile const &mapped,
+                   NuHepMC::AsciiEventScanner &scanner,
+                   NuHepMC::Skim::Predicate const &predicate,
+                   std::shared_ptr<HepMC3::GenRunInfo> const &run_info,
+                   std::string const &outfile, size_t nthreads,
+                   size_t &ninput) {
+  size_t const chunk_size = 1 << 16;
+
+  NuHepMC::EventPipeline pipeline(nthreads);
+  std::vector<NuHepMC::Skim::EventRecord> slot_records(pipeline.GetNSlots());
+  uint32_t const needs = predicate.GetNeeds();
+
+  std::vector<NuHepMC::RawEvent> chunk;
+  std::vector<char> selected;
+  // Offsets, into the mapped file, of the selected ranges of events
+  std::vector<std::pair<size_t, size_t>> ranges;
+  size_t nselected = 0;
+  ninput = 0;
+
+  NuHepMC::RawEvent raw;
+  bool more = true;
+  while (more) {
+    chunk.clear();
+    while ((chunk.size() < chunk_size) && (more = scanner.Next(raw))) {
+      chunk.push_back(raw);
+    }
+    selected.assign(chunk.size(), 0);
+
+    size_t next = 0;
+    pipeline.RunSource<size_t>(
+        [&](size_t &i) {
+          i = next++;
+          return i < chunk.size();
+        },
+        [](size_t, size_t, size_t) {},
+        [&](size_t i, size_t, size_t slot) {
+          auto &r = slot_records[slot];
+          NuHepMC::Skim::FillEventRecord(chunk[i], needs, r);
+          selected[i] = predicate(r);
+        });
+
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      if (!selected[i]) {
+        continue;
+      }
+      size_t begin = size_t(chunk[i].begin - mapped.begin());
+      size_t end = size_t(chunk[i].end - mapped.begin());
+      if (ranges.size() && (ranges.back().second == begin)) {
+        ranges.back().second = end;
+      } else {
+        ranges.emplace_back(begin, end);
+      }
+      nselected++;
+    }
+    ninput += chunk.size();
+  }
+
+  auto c = NuHepMC::CompressionFromExtension(outfile);
+  std::unique_ptr<NuHepMC::CompressedOStreamBuf> cbuf;
+  std::ofstream ofs;
+  std::vector<char> iobuf(1 << 20);
+  if (c != NuHepMC::Compression::kNone) {
+    cbuf = std::make_unique<NuHepMC::CompressedOStreamBuf>(
+        outfile, c, NuHepMC::kDefaultCompressionLevel,
+        std::max(nthreads, size_t(1)));
+  } else {
+    ofs.rdbuf()->pubsetbuf(iobuf.data(), iobuf.size());
+    ofs.open(outfile, std::ios::binary);
+  }
+  std::ostream os(cbuf ? static_cast<std::streambuf *>(cbuf.get())
+                       : ofs.rdbuf());
+
+  os << NuHepMC::FormatAsciiv3Header(
+      NuHepMC::Skim::SkimRunInfo(run_info, ninput, nselected));
+  for (auto const &range : ranges) {
+    os.write(mapped.begin() + range.first, range.second - range.first);
+  }
+  os << NuHepMC::kAsciiv3Footer;
+  os.flush();
+  if (cbuf) {
+    cbuf->Close();
+  } else {
+    ofs.close();
+  }
+  if (!os || (!cbuf && !ofs)) {
+    throw NuHepMC::SkimException() << "Failed writing " << outfile;
+  }
+  return nselected;
+}
+
+// Any other input is read into HepMC3::GenEvents twice: once to count the
+// selected events, which the run info written at the top of the output
+// needs, and once to write them.
+size_t SkimGenEvents(std::string const &filename,
+                     NuHepMC::Skim::Predicate const &predicate,
+                     std::string const &outfile, size_t nthreads,
+                     size_t &ninput) {
+  uint32_t const needs = predicate.GetNeeds();
+
+  auto reader = NuHepMC::OpenReader(filename);
+  if (!reader || reader->failed()) {
+    throw NuHepMC::SkimException() << "Failed to open " << filename;
+  }
+  HepMC3::GenEvent evt;
+  reader->read_event(evt);
+  auto run_info = reader->run_info();
+  if (!run_info) {
+    throw NuHepMC::SkimException() << filename << " has no GenRunInfo.";
+  }
+
+  NuHepMC::EventPipeline pipeline(nthreads);
+  std::vector<NuHepMC::Skim::EventRecord> slot_records(pipeline.GetNSlots());
+  std::vector<size_t> slot_nselected(pipeline.GetNSlots(), 0);
+  ninput = pipeline.Run(
+      *reader, evt, [](HepMC3::GenEvent const &, size_t, size_t) {},
+      [&](HepMC3::GenEvent const &evt, size_t, size_t slot) {
+        auto &r = slot_records[slot];
+        NuHepMC::Skim::FillEventRecord(evt, needs, r);
+        slot_nselected[slot] += predicate(r);
+      });
+  reader->close();
+
+  size_t nselected = 0;
+  for (size_t n : slot_nselected) {
+    nselected += n;
+  }
+
+  reader = NuHepMC::OpenReader(filename);
+  auto writer = NuHepMC::OpenWriterAscii(
+      outfile, NuHepMC::Skim::SkimRunInfo(run_info, ninput, nselected));
+  NuHepMC::Skim::EventRecord r;
+  reader->read_event(evt);
+  while (!reader->failed()) {
+    NuHepMC::Skim::FillEventRecord(evt, needs, r);
+    if (predicate(r)) {
+      writer->write_event(evt);
+    }
+    reader->read_event(evt);
+  }
+  reader->close();
+  writer->close();
+  if (writer->failed()) {
+    throw NuHepMC::SkimException() << "Failed writing " << outfile;
+  }
+  return nselected;
+}
+
+int main(int argc, char const *argv[]) {
+  std::string outfile;
+  size_t nthreads = 0;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-o") && ((i + 1) < argc)) {
+      outfile = argv[++i];
+    } else if ((arg == "--threads") && ((i + 1) < argc)) {
+      nthreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else if (positional.size() < 2) {
+      positional.push_back(arg);
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (outfile.empty() || (positional.size() != 2)) {
+    SayUsage(argv);
+    return 1;
+  }
+  std::string const &filename = positional[1];
+  if (outfile == filename) {
+    std::cout << "[ERROR]: The output file must not be the input file."
+              << std::endl;
+    return 1;
+  }
+
+  NuHepMC::Skim::Predicate predicate;
+  try {
+    predicate = NuHepMC::Skim::Predicate::Parse(positional[0]);
+  } catch (NuHepMC::SkimException &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<NuHepMC::MappedFile> mapped;
+  std::unique_ptr<NuHepMC::AsciiEventScanner> scanner;
+  try {
+    mapped = std::make_unique<NuHepMC::MappedFile>(filename);
+    scanner = std::make_unique<NuHepMC::AsciiEventScanner>(mapped->begin(),
+                                                           mapped->end());
+  } catch (NuHepMC::AsciiScannerException &) {
+    scanner.reset();
+    mapped.reset();
+  }
+
+  size_t ninput = 0, nselected = 0;
+  try {
+    if (scanner) {
+      nselected = SkimAsciiv3(*mapped, *scanner, predicate,
+                              NuHepMC::Merge::ReadRunInfo(filename), outfile,
+                              nthreads, ninput);
+    } else {
+      std::cout << "[INFO]: " << filename
+                << " is not an uncompressed Asciiv3 file, events will be "
+                   "read and rewritten."
+                << std::endl;
+      nselected =
+          SkimGenEvents(filename, predicate, outfile, nthreads, ninput);
+    }
+  } catch (std::exception &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::cout << "[INFO]: Selected " << nselected << " of " << ninput
+            << " events from " << filename << " into " << outfile
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,476 @@
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/CompressedStreams.hxx"
+#include "NuHepMC/EventPipeline.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/Validation.hxx"
+
+#include "HepMC3/ReaderFactory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+NEW_NuHepMC_EXCEPT(SummaryException);
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " [--threads N] [--fast] [--tolerance T] <file.hepmc3[.gz|.zst]>\n"
+      << "\t--threads N        : Summarise events on N worker threads while "
+         "the\n\t                     file is read on the main thread.\n"
+      << "\t--fast             : Read events directly from the text of a "
+         "memory-\n\t                     mapped Asciiv3 file rather than "
+         "building\n\t                     a HepMC3::GenEvent for each one.\n"
+      << "\t--tolerance T      : Relative difference between the mean TotXS "
+         "and\n\t                     NuHepMC.FluxAveragedTotalCrossSection "
+         "above\n\t                     which to warn, defaults to 0.01.\n"
+      << "\n\tPrints, for each ProcID, the number of events, the sum of the CV "
+         "weights\n\tand its statistical error, the mean TotXS (E.C.2) and "
+         "ProcXS (E.C.3),\n\tand, if the file declares G.C.4, the cross "
+         "section estimate\n\tFluxAveragedTotalCrossSection * sum(w) / "
+         "NEvents. The sums are\n\tidentical for any number of threads.\n"
+      << std::endl;
+}
+
+// Neumaier's improvement of Kahan summation: the rounding error of each
+// addition is carried separately and added back at the end, so that sums of
+// very many weights do not lose precision.
+struct StableSum {
+  double sum = 0;
+  double compensation = 0;
+
+  void Add(double x) {
+    double t = sum + x;
+    if (std::abs(sum) >= std::abs(x)) {
+      compensation += (sum - t) + x;
+    } else {
+      compensation += (x - t) + sum;
+    }
+    sum = t;
+  }
+  void Add(StableSum const &other) {
+    Add(other.sum);
+    Add(other.compensation);
+  }
+  double Value() const { return sum + compensation; }
+};
+
+// What is needed of each event.
+struct EventRecord {
+  bool has_procid = false;
+  int procid = 0;
+  double weight = 1;
+  bool has_totxs = false;
+  double totxs = 0;
+  // E.C.3, -1 if missing or unreadable
+  double procxs = -1;
+};
+
+struct ProcessSums {
+  size_t nevents = 0;
+  StableSum weight;
+  StableSum weight2;
+  size_t ntotxs = 0;
+  StableSum totxs;
+  size_t nprocxs = 0;
+  StableSum procxs;
+
+  void Add(EventRecord const &r) {
+    nevents++;
+    weight.Add(r.weight);
+    weight2.Add(r.weight * r.weight);
+    if (r.has_totxs) {
+      ntotxs++;
+      totxs.Add(r.totxs);
+    }
+    if (r.procxs != -1) {
+      nprocxs++;
+      procxs.Add(r.procxs);
+    }
+  }
+  void Add(ProcessSums const &other) {
+    nevents += other.nevents;
+    weight.Add(other.weight);
+    weight2.Add(other.weight2);
+    ntotxs += other.ntotxs;
+    totxs.Add(other.totxs);
+    nprocxs += other.nprocxs;
+    procxs.Add(other.procxs);
+  }
+};
+
+struct Summary {
+  std::map<int, ProcessSums> byprocid;
+  // Events without a ProcID, which fail E.R.2, are counted but not summed.
+  size_t nmissing_procid = 0;
+
+  void Add(EventRecord const &r) {
+    if (!r.has_procid) {
+      nmissing_procid++;
+      return;
+    }
+    byprocid[r.procid].Add(r);
+  }
+  void Add(Summary const &other) {
+    for (auto const &proc : other.byprocid) {
+      byprocid[proc.first].Add(proc.second);
+    }
+    nmissing_procid += other.nmissing_procid;
+  }
+};
+
+// Sums the records of events that arrive in any order, on any thread, in an
+// order fixed by their position in the file. The events are grouped into
+// blocks of consecutive positions, each block is summed in position order
+// once all of its events have arrived, and the block sums are added to the
+// total in block order. The result therefore does not depend on the number
+// of threads or on how the events were scheduled.
+class OrderedSummer {
+public:
+  // The block size is fixed so that every run gives the same result.
+  static constexpr size_t kBlockSize = 4096;
+
+  void Add(size_t seq, EventRecord const &r) {
+    size_t b = seq / kBlockSize;
+    std::unique_ptr<Block> full;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto &block = pending[b];
+      if (!block) {
+        block = std::make_unique<Block>();
+        block->records.resize(kBlockSize);
+      }
+      block->records[seq % kBlockSize] = r;
+      if (++block->nrecords == kBlockSize) {
+        full = std::move(block);
+        pending.erase(b);
+      }
+    }
+    if (full) {
+      Summary s = Sum(*full, kBlockSize);
+      std::lock_guard<std::mutex> lock(mutex);
+      summed.emplace(b, std::move(s));
+      Fold();
+    }
+  }
+
+  // Sums the final, partial, block, once all nevents events have been added.
+  Summary const &Finish(size_t nevents) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &block : pending) {
+      size_t n = std::min(kBlockSize, nevents - (block.first * kBlockSize));
+      if (block.second->nrecords != n) {
+        throw SummaryException()
+            << "Only " << block.second->nrecords << " of the " << n
+            << " events in block " << block.first << " were summed.";
+      }
+      summed.emplace(block.first, Sum(*block.second, n));
+    }
+    pending.clear();
+    Fold();
+    if (summed.size()) {
+      throw SummaryException() << "Not every block of events was summed.";
+    }
+    return total;
+  }
+
+private:
+  struct Block {
+    std::vector<EventRecord> records;
+    size_t nrecords = 0;
+  };
+
+  std::mutex mutex;
+  std::map<size_t, std::unique_ptr<Block>> pending;
+  std::map<size_t, Summary> summed;
+  // The next block to add to total
+  size_t next = 0;
+  Summary total;
+
+  static Summary Sum(Block const &block, size_t n) {
+    Summary s;
+    for (size_t i = 0; i < n; ++i) {
+      s.Add(block.records[i]);
+    }
+    return s;
+  }
+
+  // Adds every consecutive summed block, starting from next, to the total.
+  void Fold() {
+    for (auto it = summed.find(next); it != summed.end();
+         it = summed.find(++next)) {
+      total.Add(it->second);
+      summed.erase(it);
+    }
+  }
+};
+
+// Reads weight number index from the W line of a raw event, weights are 1
+// if the event has no W line.
+double ReadWeight(NuHepMC::RawEvent const &evt, size_t index) {
+  double weight = 1;
+  bool found = false;
+  evt.ForEachLine([&](char const *line, char const *eol) {
+    if (found || (*line != 'W')) {
+      return;
+    }
+    found = true;
+    char const *p = line + 1;
+    for (size_t i = 0; i <= index; ++i) {
+      if (!NuHepMC::Ascii::ParseDouble(p, eol, weight)) {
+        throw SummaryException() << "Event " << evt.evnum << " has only " << i
+                                 << " weights, expected at least "
+                                 << (index + 1) << ".";
+      }
+    }
+  });
+  return weight;
+}
+
+double ReadWeight(HepMC3::GenEvent const &evt, size_t index) {
+  if (evt.weights().empty()) {
+    return 1;
+  }
+  if (evt.weights().size() <= index) {
+    throw SummaryException() << "Event " << evt.event_number() << " has only "
+                             << evt.weights().size()
+                             << " weights, expected at least " << (index + 1)
+                             << ".";
+  }
+  return evt.weights()[index];
+}
+
+std::string FormatDouble(double v, int precision = 4) {
+  std::stringstream ss;
+  ss << std::setprecision(precision) << v;
+  return ss.str();
+}
+
+void PrintTable(Summary const &summary,
+                NuHepMC::StatusCodeDescriptors const &ProcessIds,
+                double fatx) {
+  ProcessSums all;
+  for (auto const &proc : summary.byprocid) {
+    all.Add(proc.second);
+  }
+  double nevents = double(all.nevents);
+
+  auto Mean = [](StableSum const &s, size_t n) {
+    return n ? FormatDouble(s.Value() / double(n)) : std::string("-");
+  };
+
+  std::cout << std::left << std::setw(8) << "ProcID" << std::setw(24)
+            << "Name" << std::right << std::setw(12) << "Events"
+            << std::setw(10) << "Fraction" << std::setw(14) << "Sum(w)"
+            << std::setw(12) << "Err" << std::setw(12) << "<TotXS>"
+            << std::setw(12) << "<ProcXS>";
+  if (fatx > 0) {
+    std::cout << std::setw(12) << "XS";
+  }
+  std::cout << std::endl;
+
+  auto Row = [&](std::string const &id, std::string const &name,
+                 ProcessSums const &s) {
+    std::cout << std::left << std::setw(8) << id << std::setw(24)
+              << name.substr(0, 23) << std::right << std::setw(12)
+              << s.nevents << std::setw(10)
+              << (nevents ? FormatDouble(double(s.nevents) / nevents, 3)
+                          : std::string("-"))
+              << std::setw(14) << FormatDouble(s.weight.Value(), 6)
+              << std::setw(12) << FormatDouble(std::sqrt(s.weight2.Value()))
+              << std::setw(12) << Mean(s.totxs, s.ntotxs) << std::setw(12)
+              << Mean(s.procxs, s.nprocxs);
+    if (fatx > 0) {
+      std::cout << std::setw(12)
+                << (nevents ? FormatDouble(fatx * s.weight.Value() / nevents)
+                            : std::string("-"));
+    }
+    std::cout << std::endl;
+  };
+
+  // Declared processes are listed even if no events were generated for them,
+  // any undeclared ProcID, which fails E.R.2, is listed after them.
+  for (auto const &proc : ProcessIds) {
+    auto it = summary.byprocid.find(proc.first);
+    Row(std::to_string(proc.first), proc.second.first,
+        (it == summary.byprocid.end()) ? ProcessSums() : it->second);
+  }
+  for (auto const &proc : summary.byprocid) {
+    if (!ProcessIds.count(proc.first)) {
+      Row(std::to_string(proc.first), "(undeclared)", proc.second);
+    }
+  }
+  Row("All", "", all);
+}
+
+int main(int argc, char const *argv[]) {
+  std::string filename;
+  size_t nthreads = 0;
+  bool fast = false;
+  double tolerance = 0.01;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "--threads") && ((i + 1) < argc)) {
+      nthreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--fast") {
+      fast = true;
+    } else if ((arg == "--tolerance") && ((i + 1) < argc)) {
+      tolerance = std::atof(argv[++i]);
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else if (filename.empty()) {
+      filename = arg;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (filename.empty()) {
+    SayUsage(argv);
+    return 1;
+  }
+
+  std::unique_ptr<NuHepMC::MappedFile> mapped;
+  std::unique_ptr<NuHepMC::AsciiEventScanner> scanner;
+  if (fast) {
+    try {
+      mapped = std::make_unique<NuHepMC::MappedFile>(filename);
+      scanner = std::make_unique<NuHepMC::AsciiEventScanner>(mapped->begin(),
+                                                             mapped->end());
+    } catch (NuHepMC::AsciiScannerException &e) {
+      std::cout << "[ERROR]: --fast requires an uncompressed Asciiv3 file: "
+                << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  std::shared_ptr<HepMC3::Reader> reader;
+  HepMC3::GenEvent evt;
+  try {
+    reader = NuHepMC::OpenReader(filename);
+    if (!reader || reader->failed()) {
+      std::cout << "[ERROR]: Failed to open " << filename << std::endl;
+      return 1;
+    }
+    reader->read_event(evt);
+  } catch (NuHepMC::CompressionException &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  auto run_info = reader->run_info();
+  if (!run_info) {
+    std::cout << "[ERROR]: " << filename << " has no GenRunInfo." << std::endl;
+    return 1;
+  }
+
+  NuHepMC::StatusCodeDescriptors ProcessIds;
+  double fatx = -1;
+  try {
+    ProcessIds = NuHepMC::GenRunInfo::ReadProcessIDDefinitions(run_info);
+    fatx = NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(
+        run_info, "NuHepMC.FluxAveragedTotalCrossSection", -1);
+  } catch (std::exception &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  // G.R.7 requires a CV weight, fall back to the first weight without one.
+  size_t cv = 0;
+  auto const &weight_names = run_info->weight_names();
+  auto cv_name = std::find(weight_names.begin(), weight_names.end(), "CV");
+  if (cv_name != weight_names.end()) {
+    cv = size_t(cv_name - weight_names.begin());
+  } else if (weight_names.size()) {
+    std::cout << "[WARN]: No CV weight is declared (G.R.7), summing weight \""
+              << weight_names.front() << "\" instead." << std::endl;
+  }
+
+  uint32_t const needs = NuHepMC::Validation::Needs::kProcID |
+                         NuHepMC::Validation::Needs::kTotXS |
+                         NuHepMC::Validation::Needs::kProcXS;
+
+  NuHepMC::EventPipeline pipeline(nthreads);
+  std::vector<NuHepMC::Validation::EventFields> slot_fields(
+      pipeline.GetNSlots());
+  OrderedSummer summer;
+
+  // evt is either a HepMC3::GenEvent or, with --fast, a NuHepMC::RawEvent.
+  auto SummariseEvent = [&](auto const &evt, size_t seq, size_t slot) {
+    auto &fields = slot_fields[slot];
+    NuHepMC::Validation::FillEventFields(evt, needs, fields);
+
+    EventRecord r;
+    r.has_procid = fields.ProcID.ok;
+    r.procid = fields.ProcID.value;
+    r.weight = ReadWeight(evt, cv);
+    r.has_totxs = fields.TotXS.ok;
+    r.totxs = fields.TotXS.value;
+    r.procxs = fields.ProcXS.ok ? fields.ProcXS.value : -1;
+    summer.Add(seq, r);
+  };
+
+  size_t nevents = 0;
+  Summary summary;
+  try {
+    if (scanner) {
+      nevents = pipeline.RunSource<NuHepMC::RawEvent>(
+          [&](NuHepMC::RawEvent &raw) { return scanner->Next(raw); },
+          [](NuHepMC::RawEvent const &, size_t, size_t) {}, SummariseEvent);
+    } else {
+      nevents = pipeline.Run(
+          *reader, evt, [](HepMC3::GenEvent const &, size_t, size_t) {},
+          SummariseEvent);
+    }
+    summary = summer.Finish(nevents);
+  } catch (std::exception &e) {
+    std::cout << "[ERROR]: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::cout << "[INFO]: Read " << nevents << " events." << std::endl;
+  if (summary.nmissing_procid) {
+    std::cout << "[WARN]: " << summary.nmissing_procid
+              << " events have no ProcID (E.R.2) and are not summarised."
+              << std::endl;
+  }
+
+  PrintTable(summary, ProcessIds, fatx);
+
+  ProcessSums all;
+  for (auto const &proc : summary.byprocid) {
+    all.Add(proc.second);
+  }
+  if (fatx > 0) {
+    std::cout << "NuHepMC.FluxAveragedTotalCrossSection: " << fatx
+              << std::endl;
+    if (all.ntotxs) {
+      double mean = all.totxs.Value() / double(all.ntotxs);
+      double reldiff = (mean - fatx) / fatx;
+      std::cout << "Mean TotXS: " << mean << " (" << std::showpos
+                << FormatDouble(100 * reldiff, 3) << std::noshowpos << "%)"
+                << std::endl;
+      if (std::abs(reldiff) > tolerance) {
+        std::cout << "[WARN]: The mean TotXS differs from "
+                     "NuHepMC.FluxAveragedTotalCrossSection by more than "
+                  << FormatDouble(100 * tolerance, 3) << "%." << std::endl;
+      }
+    }
+  } else {
+    std::cout << "[INFO]: No NuHepMC.FluxAveragedTotalCrossSection (G.C.4) is "
+                 "declared, cross section estimates are not shown."
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "NuHepMC/ReaderUtils.hxx"
+
+#include "BenchmarkUtils.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Count every heap allocation made by the process so that the steady-state
+// allocations of each accessor can be reported.
+NuHepMC_COUNT_ALLOCATIONS()
+
+// The CheckedAttributeValue implementation that AttributeHandle was written
+// to replace, kept as the baseline.
+template <typename AT, typename T>
+auto LegacyCheckedAttributeValue(T const &obj, std::string const &name) {
+  if (!obj) {
+    throw NuHepMC::NullObjectException();
+  }
+
+  if (!NuHepMC::HasAttribute(obj, name)) {
+    throw NuHepMC::MissingAttributeException() << name;
+  }
+
+  if (!obj->template attribute<AT>(name)) {
+    throw NuHepMC::AttributeTypeException()
+        << name << ": " << obj->attribute_as_string(name);
+  }
+
+  return obj->template attribute<AT>(name)->value();
+}
+
+int main(int argc, char const *argv[]) {
+  size_t niter = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  auto run_info = std::make_shared<HepMC3::GenRunInfo>();
+  run_info->set_weight_names({"CV"});
+
+  HepMC3::GenEvent evt(run_info, HepMC3::Units::MEV, HepMC3::Units::MM);
+  evt.add_attribute("ProcID", std::make_shared<HepMC3::IntAttribute>(200));
+  evt.add_attribute("TotXS", std::make_shared<HepMC3::DoubleAttribute>(1.2));
+  evt.add_attribute("ProcXS", std::make_shared<HepMC3::DoubleAttribute>(0.8));
+  evt.add_attribute("LabPos", std::make_shared<HepMC3::VectorDoubleAttribute>(
+                                  std::vector<double>{0, 0, 0, 1}));
+  // Some generator-specific attributes to make the name scans realistic.
+  for (int i = 0; i < 8; ++i) {
+    evt.add_attribute("MyGen.Extra" + std::to_string(i),
+                      std::make_shared<HepMC3::DoubleAttribute>(i));
+  }
+
+  std::cout << "Accessing ProcID, TotXS, ProcXS and LabPos " << niter
+            << " times:" << std::endl;
+
+  Bench::Time("Legacy CheckedAttributeValue", niter, 1, [&]() {
+    return LegacyCheckedAttributeValue<HepMC3::IntAttribute>(&evt, "ProcID") +
+           LegacyCheckedAttributeValue<HepMC3::DoubleAttribute>(&evt,
+                                                                "TotXS") +
+           LegacyCheckedAttributeValue<HepMC3::DoubleAttribute>(&evt,
+                                                                "ProcXS") +
+           LegacyCheckedAttributeValue<HepMC3::VectorDoubleAttribute>(
+               &evt, "LabPos")[3];
+  });
+
+  Bench::Time("CheckedAttributeValue", niter, 1, [&]() {
+    return NuHepMC::CheckedAttributeValue<HepMC3::IntAttribute>(&evt,
+                                                               "ProcID") +
+           NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(&evt,
+                                                                  "TotXS") +
+           NuHepMC::CheckedAttributeValue<HepMC3::DoubleAttribute>(&evt,
+                                                                  "ProcXS") +
+           NuHepMC::CheckedAttributeValue<HepMC3::VectorDoubleAttribute>(
+               &evt, "LabPos")[3];
+  });
+
+  NuHepMC::AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+  NuHepMC::AttributeHandle<HepMC3::DoubleAttribute> TotXS("TotXS");
+  NuHepMC::AttributeHandle<HepMC3::DoubleAttribute> ProcXS("ProcXS");
+  NuHepMC::AttributeHandle<HepMC3::VectorDoubleAttribute> LabPos("LabPos");
+
+  Bench::Time("AttributeHandle::Value", niter, 1, [&]() {
+    return ProcID.Value(&evt) + TotXS.Value(&evt) + ProcXS.Value(&evt) +
+           LabPos.Value(&evt)[3];
+  });
+}
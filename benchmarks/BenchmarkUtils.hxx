@@ -0,0 +1,56 @@
+#pragma once
+
+#include "NuHepMC/Profiling.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+// Timing shared by the micro-benchmarks. The heap allocations of each
+// method are reported alongside its time, which needs the benchmark to place
+// NuHepMC_COUNT_ALLOCATIONS() once at global scope, otherwise they read 0.
+namespace Bench {
+
+// Calls f ncalls times, each call processing nevents events, and reports the
+// mean time and number of heap allocations per event. If f returns a number,
+// the sum of the returned values is reported as a checksum, so that the
+// methods being compared can be seen to agree and so that their work is not
+// optimised away.
+template <typename F>
+void Time(std::string const &label, size_t ncalls, size_t nevents,
+          F const &f) {
+  constexpr bool has_checksum = !std::is_void<decltype(f())>::value;
+  double checksum = 0;
+
+  uint64_t allocs_before = NuHepMC::Profiling::GetNAllocations();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ncalls; ++i) {
+    if constexpr (has_checksum) {
+      checksum += f();
+    } else {
+      f();
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  uint64_t allocs = NuHepMC::Profiling::GetNAllocations() - allocs_before;
+
+  double ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count();
+  double nevt = double(ncalls) * double(nevents);
+  std::cout << std::left << std::setw(32) << label << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << (ns / nevt) << " ns/evt" << std::setw(10)
+            << std::setprecision(2) << (double(allocs) / nevt)
+            << " allocs/evt";
+  if (has_checksum) {
+    std::cout << "  (checksum: " << std::setprecision(6) << checksum << ")";
+  }
+  std::cout << std::endl;
+}
+
+} // namespace Bench
@@ -0,0 +1,104 @@
+#include "NuHepMC/EventBuilder.hxx"
+
+#include "BenchmarkUtils.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/GenVertex.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Count every heap allocation made by the process so that the steady-state
+// allocations of each way of building an event can be reported.
+NuHepMC_COUNT_ALLOCATIONS()
+
+// The std::make_shared of the original BuildEvent, as the baseline.
+struct MakeShared {
+  template <typename T, typename... Args>
+  std::shared_ptr<T> Make(Args &&...args) const {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+};
+
+// The content of the NuHepMCReferenceWriter event, with every object created
+// through factory.
+template <typename Factory>
+void FillEvent(Factory const &factory, HepMC3::GenEvent &evt) {
+  evt.weight("CV") = 1;
+  evt.add_attribute("ProcID",
+                    factory.template Make<HepMC3::IntAttribute>(200));
+  evt.add_attribute("TotXS",
+                    factory.template Make<HepMC3::DoubleAttribute>(1.2));
+  evt.add_attribute("ProcXS",
+                    factory.template Make<HepMC3::DoubleAttribute>(0.8));
+  evt.add_attribute("LabPos",
+                    factory.template Make<HepMC3::VectorDoubleAttribute>(
+                        std::vector<double>{0, 0, 0, 0}));
+
+  auto Particle = [&](int pid, int status) {
+    return factory.template Make<HepMC3::GenParticle>(
+        HepMC3::FourVector{1, 2, 3, 4}, pid, status);
+  };
+
+  auto primvertex =
+      factory.template Make<HepMC3::GenVertex>(HepMC3::FourVector{});
+  primvertex->set_status(NuHepMC::VertexStatus::kPrimaryVertex);
+  primvertex->add_particle_in(
+      Particle(2112, NuHepMC::ParticleStatus::kTargetParticle));
+  primvertex->add_particle_in(
+      Particle(14, NuHepMC::ParticleStatus::kIncomingBeamParticle));
+  primvertex->add_particle_out(
+      Particle(13, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle));
+  primvertex->add_particle_out(
+      Particle(2212, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle));
+  auto FSIPiPlus = Particle(211, 21);
+  primvertex->add_particle_out(FSIPiPlus);
+  evt.add_vertex(primvertex);
+
+  auto fsivertex = factory.template Make<HepMC3::GenVertex>(
+      HepMC3::FourVector{1E-10, 2E-10, 3E-10, 4E-10});
+  fsivertex->set_status(2);
+  fsivertex->add_particle_in(FSIPiPlus);
+  fsivertex->add_particle_out(
+      Particle(2212, NuHepMC::ParticleStatus::kUndecayedPhysicalParticle));
+  evt.add_vertex(fsivertex);
+}
+
+int main(int argc, char const *argv[]) {
+  size_t niter = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  auto run_info = std::make_shared<HepMC3::GenRunInfo>();
+  run_info->set_weight_names({"CV"});
+
+  std::cout << "Building " << niter << " events:" << std::endl;
+
+  Bench::Time("make_shared, new GenEvent", niter, 1, [&]() {
+    HepMC3::GenEvent evt(run_info, HepMC3::Units::MEV, HepMC3::Units::MM);
+    FillEvent(MakeShared(), evt);
+  });
+
+  HepMC3::GenEvent reused(run_info, HepMC3::Units::MEV, HepMC3::Units::MM);
+  Bench::Time("make_shared, reused GenEvent", niter, 1, [&]() {
+    reused.clear();
+    reused.set_run_info(run_info);
+    reused.weights().assign(1, 1);
+    FillEvent(MakeShared(), reused);
+  });
+
+  NuHepMC::EventBuilder builder(run_info);
+  Bench::Time("EventBuilder, reused GenEvent", niter, 1, [&]() {
+    builder.Reset(reused);
+    FillEvent(builder, reused);
+  });
+  reused.clear();
+
+  std::cout << "EventBuilder pool: " << builder.GetPool().NAllocated()
+            << " blocks allocated, " << builder.GetPool().NFree() << " free."
+            << std::endl;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "NuHepMC/EventBuilder.hxx"
+#include "NuHepMC/ReferenceEvents.hxx"
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Synthetic, NuHepMC-conforming events for benchmarking. The run info and
+// events are built by NuHepMC::Reference, as NuHepMCReferenceWriter builds
+// them, with the size and shape of each event made configurable and random
+// momenta. The default configuration has the shape of the reference event:
+// three primary products, one of which undergoes a single FSI step, one CV
+// weight and ProcIDs 200, 300 and 500 in equal measure.
+namespace Synthetic {
+
+struct Config {
+  // The number of particles leaving the primary vertex, including the
+  // charged lepton.
+  size_t multiplicity = 3;
+  // The number of FSI vertices that the last primary hadron passes through
+  // before leaving the nucleus.
+  size_t fsi_depth = 1;
+  // The length of the weight vector, the first weight is always CV.
+  size_t nweights = 1;
+  // ProcID -> relative frequency.
+  std::map<int, double> procid_mix = {{200, 1}, {300, 1}, {500, 1}};
+  uint64_t seed = 1;
+  // Written to NuHepMC.Exposure.NEvents
+  size_t nevents = 3;
+};
+
+// Parses a ProcID mix of the form 200:0.5,300:0.3,500:0.2
+inline std::map<int, double> ParseProcIDMix(std::string const &str) {
+  std::map<int, double> mix;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    auto colon = item.find(':');
+    int procid = std::atoi(item.substr(0, colon).c_str());
+    mix[procid] = (colon == std::string::npos)
+                      ? 1
+                      : std::atof(item.substr(colon + 1).c_str());
+  }
+  return mix;
+}
+
+// A small, fully specified generator so that the same seed gives the same
+// workload with every standard library, unlike the std:: distributions.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed) {}
+
+  // splitmix64
+  uint64_t Next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1)
+  double Uniform() { return double(Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+  uint64_t state;
+};
+
+inline std::shared_ptr<HepMC3::GenRunInfo>
+BuildGenRunInfo(Config const &config) {
+  auto ProcessIDs = NuHepMC::Reference::ProcessIDs();
+  for (auto const &proc : config.procid_mix) {
+    if (!ProcessIDs.count(proc.first)) {
+      ProcessIDs[proc.first] = {"Synthetic" + std::to_string(proc.first),
+                                "A synthetic process"};
+    }
+  }
+
+  std::vector<std::string> weight_names = {"CV"};
+  for (size_t i = 1; i < config.nweights; ++i) {
+    weight_names.push_back("Var" + std::to_string(i));
+  }
+
+  return NuHepMC::Reference::BuildGenRunInfo(ProcessIDs, weight_names,
+                                             int(config.nevents));
+}
+
+// Builds events one after another from a fixed seed, so that a given Config
+// always produces the same sequence of events.
+class EventGenerator {
+public:
+  EventGenerator(std::shared_ptr<HepMC3::GenRunInfo> run_info,
+                 Config const &config)
+      : builder(std::move(run_info)), config(config), rng(config.seed) {
+    double total = 0;
+    for (auto const &proc : config.procid_mix) {
+      total += proc.second;
+    }
+    double cumulative = 0;
+    for (auto const &proc : config.procid_mix) {
+      cumulative += proc.second / total;
+      procid_cdf.emplace_back(cumulative, proc.first);
+    }
+  }
+
+  // Fills evt, which is cleared first, with the next event.
+  void Build(HepMC3::GenEvent &evt, int evnum) {
+    static const NuHepMC::Reference::Particle hadrons[] = {
+        {{}, 2212, 9.3827200000000005e+02}, {{}, 2112, 9.3956499999999994e+02},
+        {{}, 211, 1.3957039000000000e+02},  {{}, -211, 1.3957039000000000e+02},
+        {{}, 111, 1.3497680000000000e+02},
+    };
+    size_t const nhadrons = sizeof(hadrons) / sizeof(hadrons[0]);
+
+    auto const &reference = NuHepMC::Reference::ReferenceEventContent();
+    content.target = Particle(reference.target, 250);
+    content.beam = reference.beam;
+
+    content.products.clear();
+    content.products.push_back(Particle(reference.products.front(), 1000));
+    for (size_t i = 1; i < config.multiplicity; ++i) {
+      content.products.push_back(Particle(hadrons[rng.Next() % nhadrons], 500));
+    }
+
+    content.fsi.clear();
+    if (content.products.size() > 1) {
+      for (size_t d = 0; d < config.fsi_depth; ++d) {
+        content.fsi.push_back(Particle(hadrons[0], 400));
+      }
+    }
+    // E.C.5
+    content.LabPos = {0, 0, 0, evnum * 1E-6};
+
+    NuHepMC::Reference::BuildEvent(builder, content, evt);
+
+    // E.R.1
+    evt.set_event_number(evnum);
+    // E.R.2
+    builder.SetProcID(evt, NextProcID());
+    for (size_t i = 1; i < config.nweights; ++i) {
+      evt.weights()[i] = 0.5 + rng.Uniform();
+    }
+  }
+
+private:
+  NuHepMC::EventBuilder builder;
+  Config config;
+  Random rng;
+  std::vector<std::pair<double, int>> procid_cdf;
+  NuHepMC::Reference::EventContent content;
+
+  int NextProcID() {
+    double u = rng.Uniform();
+    for (auto const &p : procid_cdf) {
+      if (u < p.first) {
+        return p.second;
+      }
+    }
+    return procid_cdf.back().second;
+  }
+
+  // p, on-shell with a random momentum of magnitude up to pmax.
+  NuHepMC::Reference::Particle Particle(NuHepMC::Reference::Particle p,
+                                        double pmax) {
+    double px = pmax * (2 * rng.Uniform() - 1);
+    double py = pmax * (2 * rng.Uniform() - 1);
+    double pz = pmax * rng.Uniform();
+    double e = std::sqrt(px * px + py * py + pz * pz + p.mass * p.mass);
+    p.momentum = HepMC3::FourVector{px, py, pz, e};
+    return p;
+  }
+};
+
+} // namespace Synthetic
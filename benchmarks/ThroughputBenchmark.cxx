@@ -0,0 +1,332 @@
+#include "SyntheticEvents.hxx"
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/EventNumberTracker.hxx"
+#include "NuHepMC/JSONUtils.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/Skim.hxx"
+#include "NuHepMC/Validation.hxx"
+
+#include "HepMC3/ReaderAscii.h"
+#include "HepMC3/WriterAscii.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Peak resident set size in kB. On Linux the high-water mark is reset between
+// phases so that each phase reports its own peak, elsewhere the peak is that
+// of the process so far.
+void ResetPeakRSS() {
+  std::ofstream("/proc/self/clear_refs") << "5" << std::endl;
+}
+
+long PeakRSSkB() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+long FileSize(std::string const &filename) {
+  std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+  return ifs ? long(ifs.tellg()) : 0;
+}
+
+struct PhaseResult {
+  std::string name;
+  size_t nevents;
+  double seconds;
+  // 0 for phases that do not touch the file
+  long bytes;
+  long peak_rss_kB;
+};
+
+// Runs f, which returns the number of events processed, and records the
+// throughput of the phase.
+template <typename F>
+PhaseResult Time(std::string const &name, long bytes, F const &f) {
+  ResetPeakRSS();
+  auto start = std::chrono::steady_clock::now();
+  size_t nevents = f();
+  auto end = std::chrono::steady_clock::now();
+
+  return PhaseResult{name, nevents,
+                     std::chrono::duration<double>(end - start).count(), bytes,
+                     PeakRSSkB()};
+}
+
+void Print(PhaseResult const &res) {
+  std::cout << std::left << std::setw(16) << res.name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(0)
+            << (res.nevents / res.seconds) << " evts/s";
+  if (res.bytes) {
+    std::cout << std::setw(10) << std::setprecision(1)
+              << (res.bytes / res.seconds / (1 << 20)) << " MB/s";
+  } else {
+    std::cout << std::setw(15) << "";
+  }
+  std::cout << std::setw(10) << res.peak_rss_kB << " kB peak RSS" << std::endl;
+}
+
+void SayUsage(char const *argv[]) {
+  std::cout
+      << "[RUNLIKE]: " << argv[0]
+      << " [-n N] [--multiplicity M] [--fsi-depth D] [--nweights W] "
+         "[--procids 200:1,300:1] [--seed S] [-o file.hepmc3] [--json "
+         "results.json]\n"
+      << "\t-n N               : Number of events, defaults to 100000.\n"
+      << "\t--multiplicity M   : Particles leaving the primary vertex, "
+         "defaults to 3.\n"
+      << "\t--fsi-depth D      : FSI steps taken by the last primary "
+         "hadron,\n\t                     defaults to 1.\n"
+      << "\t--nweights W       : Length of the weight vector, defaults to 1.\n"
+      << "\t--procids <mix>    : ProcID:frequency pairs, defaults to\n"
+         "\t                     200:1,300:1,500:1.\n"
+      << "\t--seed S           : Random seed, defaults to 1.\n"
+      << "\t-o <file>          : Where to write the events, defaults to\n"
+         "\t                     NuHepMCThroughputBenchmark.hepmc3.\n"
+      << "\t--json <file>      : Where to write the results, defaults to\n"
+         "\t                     NuHepMCThroughputBenchmark.json.\n"
+      << std::endl;
+}
+
+int main(int argc, char const *argv[]) {
+  Synthetic::Config config;
+  config.nevents = 100000;
+  std::string events_file = "NuHepMCThroughputBenchmark.hepmc3";
+  std::string json_file = "NuHepMCThroughputBenchmark.json";
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "-n") && ((i + 1) < argc)) {
+      config.nevents = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "--multiplicity") && ((i + 1) < argc)) {
+      config.multiplicity = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "--fsi-depth") && ((i + 1) < argc)) {
+      config.fsi_depth = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "--nweights") && ((i + 1) < argc)) {
+      config.nweights = std::strtoul(argv[++i], nullptr, 10);
+    } else if ((arg == "--procids") && ((i + 1) < argc)) {
+      config.procid_mix = Synthetic::ParseProcIDMix(argv[++i]);
+    } else if ((arg == "--seed") && ((i + 1) < argc)) {
+      config.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if ((arg == "-o") && ((i + 1) < argc)) {
+      events_file = argv[++i];
+    } else if ((arg == "--json") && ((i + 1) < argc)) {
+      json_file = argv[++i];
+    } else if ((arg == "-?") || (arg == "--help")) {
+      SayUsage(argv);
+      return 0;
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayUsage(argv);
+      return 1;
+    }
+  }
+
+  if (!config.multiplicity || !config.nweights || config.procid_mix.empty()) {
+    std::cout << "[ERROR]: --multiplicity, --nweights and --procids must be "
+                 "non-empty."
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<PhaseResult> results;
+
+  // Event construction alone, the baseline that the write phase includes.
+  results.push_back(Time("generate", 0, [&]() {
+    auto run_info = Synthetic::BuildGenRunInfo(config);
+    Synthetic::EventGenerator gen(run_info, config);
+    HepMC3::GenEvent evt;
+    for (size_t i = 0; i < config.nevents; ++i) {
+      gen.Build(evt, int(i + 1));
+    }
+    return config.nevents;
+  }));
+
+  // The file size is only known once the file is written.
+  results.push_back(Time("write", 0, [&]() {
+    auto run_info = Synthetic::BuildGenRunInfo(config);
+    Synthetic::EventGenerator gen(run_info, config);
+    HepMC3::WriterAscii writer(events_file, run_info);
+    HepMC3::GenEvent evt;
+    for (size_t i = 0; i < config.nevents; ++i) {
+      gen.Build(evt, int(i + 1));
+      writer.write_event(evt);
+    }
+    writer.close();
+    return config.nevents;
+  }));
+  long const nbytes = FileSize(events_file);
+  results.back().bytes = nbytes;
+
+  // As above, with the writing overlapped with generation by an AsyncWriter.
+  results.push_back(Time("write_async", nbytes, [&]() {
+    auto run_info = Synthetic::BuildGenRunInfo(config);
+    Synthetic::EventGenerator gen(run_info, config);
+    NuHepMC::AsyncWriter writer(
+        std::make_shared<HepMC3::WriterAscii>(events_file, run_info));
+    for (size_t i = 0; i < config.nevents; ++i) {
+      auto evt = writer.GetEvent();
+      gen.Build(*evt, int(i + 1));
+      writer.Write(std::move(evt));
+    }
+    writer.Close();
+    return config.nevents;
+  }));
+
+  results.push_back(Time("read", nbytes, [&]() {
+    HepMC3::ReaderAscii reader(events_file);
+    HepMC3::GenEvent evt;
+    size_t nevents = 0;
+    reader.read_event(evt);
+    while (!reader.failed()) {
+      nevents++;
+      reader.read_event(evt);
+    }
+    return nevents;
+  }));
+
+  // The event-level part of NuHepMCReferenceValidator, single-threaded.
+  std::unique_ptr<NuHepMC::Validation::ValidationPlan> plan;
+  size_t nfailed = 0;
+  results.push_back(Time("validate", nbytes, [&]() {
+    HepMC3::ReaderAscii reader(events_file);
+    HepMC3::GenEvent evt;
+    reader.read_event(evt);
+    auto run_info = reader.run_info();
+    plan = std::make_unique<NuHepMC::Validation::ValidationPlan>(
+        NuHepMC::GenRunInfo::ReadConventions(run_info),
+        NuHepMC::Validation::RunDefinitions{
+            NuHepMC::GenRunInfo::ReadProcessIDDefinitions(run_info),
+            NuHepMC::GenRunInfo::ReadVertexStatusIDDefinitions(run_info),
+            NuHepMC::GenRunInfo::ReadParticleStatusIDDefinitions(run_info)});
+
+    NuHepMC::EventNumberTracker event_numbers;
+    NuHepMC::Validation::EventFields fields;
+    size_t nevents = 0;
+    while (!reader.failed()) {
+      nfailed += !event_numbers.Insert(evt.event_number());
+      NuHepMC::Validation::FillEventFields(evt, plan->GetNeeds(), fields);
+      nfailed += bool(plan->Check(fields));
+      nevents++;
+      reader.read_event(evt);
+    }
+    return nevents;
+  }));
+
+  // As above, but through the --fast text scanner.
+  results.push_back(Time("validate_fast", nbytes, [&]() {
+    NuHepMC::MappedFile mapped(events_file);
+    NuHepMC::AsciiEventScanner scanner(mapped.begin(), mapped.end());
+
+    NuHepMC::EventNumberTracker event_numbers;
+    NuHepMC::Validation::EventFields fields;
+    NuHepMC::RawEvent raw;
+    size_t nevents = 0;
+    while (scanner.Next(raw)) {
+      nfailed += !event_numbers.Insert(raw.evnum);
+      NuHepMC::Validation::FillEventFields(raw, plan->GetNeeds(), fields);
+      nfailed += bool(plan->Check(fields));
+      nevents++;
+    }
+    return nevents;
+  }));
+
+  // Event selection as NuHepMCSkim does it, from GenEvents, whose particles
+  // are flattened by an EventView, and from the text of each event.
+  auto const selection = NuHepMC::Skim::Predicate::Parse(
+      "ProcID in {200, 300} && any(abspdg == 211 && status == 1)");
+  size_t nselected = 0, nselected_fast = 0;
+  results.push_back(Time("skim", nbytes, [&]() {
+    HepMC3::ReaderAscii reader(events_file);
+    HepMC3::GenEvent evt;
+    NuHepMC::Skim::EventRecord r;
+    size_t nevents = 0;
+    reader.read_event(evt);
+    while (!reader.failed()) {
+      NuHepMC::Skim::FillEventRecord(evt, selection.GetNeeds(), r);
+      nselected += selection(r);
+      nevents++;
+      reader.read_event(evt);
+    }
+    return nevents;
+  }));
+
+  results.push_back(Time("skim_fast", nbytes, [&]() {
+    NuHepMC::MappedFile mapped(events_file);
+    NuHepMC::AsciiEventScanner scanner(mapped.begin(), mapped.end());
+
+    NuHepMC::Skim::EventRecord r;
+    NuHepMC::RawEvent raw;
+    size_t nevents = 0;
+    while (scanner.Next(raw)) {
+      NuHepMC::Skim::FillEventRecord(raw, selection.GetNeeds(), r);
+      nselected_fast += selection(r);
+      nevents++;
+    }
+    return nevents;
+  }));
+
+  for (auto const &res : results) {
+    Print(res);
+  }
+
+  if (nfailed) {
+    std::cout << "[WARN]: " << nfailed
+              << " synthetic events failed validation." << std::endl;
+  }
+  if (nselected != nselected_fast) {
+    std::cout << "[WARN]: The skim selected " << nselected
+              << " events from GenEvents but " << nselected_fast
+              << " from the event text." << std::endl;
+    nfailed++;
+  }
+
+  std::ofstream os(json_file);
+  os << "{\n  \"config\": {\n    \"nevents\": " << config.nevents
+     << ",\n    \"multiplicity\": " << config.multiplicity
+     << ",\n    \"fsi_depth\": " << config.fsi_depth
+     << ",\n    \"nweights\": " << config.nweights
+     << ",\n    \"seed\": " << config.seed << ",\n    \"procids\": {";
+  bool first = true;
+  for (auto const &proc : config.procid_mix) {
+    os << (first ? "" : ", ")
+       << NuHepMC::JSONQuote(std::to_string(proc.first)) << ": "
+       << proc.second;
+    first = false;
+  }
+  os << "}\n  },\n  \"file_bytes\": " << nbytes << ",\n  \"phases\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto const &res = results[i];
+    os << (i ? "," : "")
+       << "\n    {\"name\": " << NuHepMC::JSONQuote(res.name)
+       << ", \"nevents\": " << res.nevents << ", \"seconds\": " << res.seconds
+       << ", \"events_per_second\": " << (res.nevents / res.seconds)
+       << ", \"bytes_per_second\": "
+       << (res.bytes ? (res.bytes / res.seconds) : 0)
+       << ", \"peak_rss_kB\": " << res.peak_rss_kB << "}";
+  }
+  os << "\n  ]\n}" << std::endl;
+
+  std::cout << "[INFO]: Wrote results to " << json_file << std::endl;
+  return nfailed ? 1 : 0;
+}
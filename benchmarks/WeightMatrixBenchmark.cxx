@@ -0,0 +1,100 @@
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/WeightMatrix.hxx"
+
+#include "BenchmarkUtils.hxx"
+#include "SyntheticEvents.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Count every heap allocation made by the process so that the allocations of
+// each method can be reported.
+NuHepMC_COUNT_ALLOCATIONS()
+
+// Every method sums every weight of every event, per ProcID, and returns a
+// checksum of the sums so that the methods can be seen to agree.
+double Checksum(NuHepMC::Weights::WeightSums const &sums) {
+  auto total = sums.GetTotal();
+  double checksum = 0;
+  for (size_t j = 0; j < total.sum.size(); ++j) {
+    checksum += total.sum[j] + total.sum2[j];
+  }
+  return checksum;
+}
+
+int main(int argc, char const *argv[]) {
+  size_t nevents = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  size_t nweights = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 200;
+  size_t nrepeats = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 10;
+
+  Synthetic::Config config;
+  config.nweights = nweights;
+  config.nevents = nevents;
+  auto run_info = Synthetic::BuildGenRunInfo(config);
+  Synthetic::EventGenerator gen(run_info, config);
+
+  std::vector<HepMC3::GenEvent> events(nevents);
+  for (size_t i = 0; i < nevents; ++i) {
+    gen.Build(events[i], int(i));
+  }
+
+  std::cout << "Summing " << nweights << " weights per ProcID over "
+            << nevents << " events, " << nrepeats << " times:" << std::endl;
+
+  auto const &names = run_info->weight_names();
+  Bench::Time("GenEvent::weight(name)", nrepeats, nevents, [&]() {
+    NuHepMC::AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+    std::map<int, NuHepMC::Weights::WeightSum> byprocid;
+    for (auto const &evt : events) {
+      auto it = byprocid.find(ProcID.Value(&evt));
+      if (it == byprocid.end()) {
+        it = byprocid
+                 .emplace(ProcID.Value(&evt),
+                          NuHepMC::Weights::WeightSum(nweights))
+                 .first;
+      }
+      it->second.nevents++;
+      for (size_t j = 0; j < nweights; ++j) {
+        double w = evt.weight(names[j]);
+        it->second.sum[j] += w;
+        it->second.sum2[j] += w * w;
+      }
+    }
+    NuHepMC::Weights::WeightSum total(nweights);
+    for (auto const &proc : byprocid) {
+      total += proc.second;
+    }
+    double checksum = 0;
+    for (size_t j = 0; j < nweights; ++j) {
+      checksum += total.sum[j] + total.sum2[j];
+    }
+    return checksum;
+  });
+
+  for (auto layout : {NuHepMC::Weights::Layout::kRowMajor,
+                      NuHepMC::Weights::Layout::kColumnMajor}) {
+    bool row = (layout == NuHepMC::Weights::Layout::kRowMajor);
+    NuHepMC::Weights::WeightMatrix matrix(run_info, {}, 4096, layout);
+    char const *label =
+        row ? "WeightMatrix, row-major" : "WeightMatrix, column-major";
+    Bench::Time(label, nrepeats, nevents, [&]() {
+      NuHepMC::Weights::WeightSums sums(matrix.NWeights());
+      for (auto const &evt : events) {
+        if (matrix.Add(evt)) {
+          sums.Accumulate(matrix);
+          matrix.Clear();
+        }
+      }
+      sums.Accumulate(matrix);
+      matrix.Clear();
+      return Checksum(sums);
+    });
+  }
+}
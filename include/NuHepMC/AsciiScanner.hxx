@@ -0,0 +1,261 @@
+#pragma once
+
+#include "NuHepMC/Exceptions.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(AsciiScannerException);
+
+// A read-only memory mapping of a whole file. advice is passed to madvise,
+// the default suits files that are read front to back, exactly once.
+class MappedFile {
+public:
+  explicit MappedFile(std::string const &filename,
+                      int advice = MADV_SEQUENTIAL) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw AsciiScannerException() << "Failed to open " << filename;
+    }
+    struct stat st;
+    if (::fstat(fd, &st)) {
+      ::close(fd);
+      throw AsciiScannerException() << "Failed to stat " << filename;
+    }
+    size = size_t(st.st_size);
+    if (size) {
+      void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        throw AsciiScannerException() << "Failed to map " << filename;
+      }
+      data = static_cast<char const *>(addr);
+      ::madvise(addr, size, advice);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  ~MappedFile() {
+    if (data) {
+      ::munmap(const_cast<char *>(data), size);
+    }
+  }
+
+  char const *begin() const { return data; }
+  char const *end() const { return data + size; }
+  size_t GetSize() const { return size; }
+
+private:
+  char const *data = nullptr;
+  size_t size = 0;
+};
+
+// Bounded number parsing for text that is not null-terminated, which only
+// allocates for unusually long tokens.
+// Leading blanks are skipped and p is advanced past the token. The conversions
+// are those of std::atoi and std::atof, which HepMC3 uses to parse attributes.
+namespace Ascii {
+
+inline char const *SkipBlanks(char const *p, char const *end) {
+  while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+    ++p;
+  }
+  return p;
+}
+
+inline char const *TokenEnd(char const *p, char const *end) {
+  while ((p < end) && (*p != ' ') && (*p != '\t') && (*p != '\n') &&
+         (*p != '\r')) {
+    ++p;
+  }
+  return p;
+}
+
+inline bool ParseInt(char const *&p, char const *end, long &out) {
+  p = SkipBlanks(p, end);
+  char const *q = p;
+  bool neg = false;
+  if ((q < end) && ((*q == '-') || (*q == '+'))) {
+    neg = (*q == '-');
+    ++q;
+  }
+  if ((q == end) || (*q < '0') || (*q > '9')) {
+    return false;
+  }
+  long v = 0;
+  while ((q < end) && (*q >= '0') && (*q <= '9')) {
+    v = v * 10 + (*q - '0');
+    ++q;
+  }
+  out = neg ? -v : v;
+  p = TokenEnd(q, end);
+  return true;
+}
+
+// Tokens are copied to be null-terminated for std::strtod, into a stack buffer
+// unless they are too long for it, e.g. numbers written with many digits.
+inline bool ParseDouble(char const *&p, char const *end, double &out) {
+  p = SkipBlanks(p, end);
+  char const *tend = TokenEnd(p, end);
+  size_t len = size_t(tend - p);
+  if (!len) {
+    return false;
+  }
+  char buf[64];
+  std::string long_token;
+  char *str = buf;
+  if (len < sizeof(buf)) {
+    std::memcpy(buf, p, len);
+    buf[len] = '\0';
+  } else {
+    long_token.assign(p, len);
+    str = &long_token[0];
+  }
+  char *pend;
+  out = std::strtod(str, &pend);
+  p = tend;
+  return pend != str;
+}
+
+inline void SkipToken(char const *&p, char const *end) {
+  p = TokenEnd(SkipBlanks(p, end), end);
+}
+
+inline bool StartsWith(char const *p, char const *end, char const *prefix,
+                       size_t len) {
+  return (size_t(end - p) >= len) && !std::memcmp(p, prefix, len);
+}
+
+} // namespace Ascii
+
+// The text of a single event in an Asciiv3 buffer, from its E line up to the
+// start of the next event or of the end-of-listing footer.
+struct RawEvent {
+  char const *begin = nullptr;
+  char const *end = nullptr;
+  int evnum = 0;
+
+  // Calls f(line_begin, line_end) for each line, line_end excludes the
+  // newline.
+  template <typename F> void ForEachLine(F const &f) const {
+    char const *line = begin;
+    while (line < end) {
+      char const *eol =
+          static_cast<char const *>(std::memchr(line, '\n', end - line));
+      if (!eol) {
+        eol = end;
+      }
+      f(line, eol);
+      line = eol + 1;
+    }
+  }
+};
+
+// Splits an Asciiv3 buffer, typically a MappedFile, into its header and
+// events without copying or parsing them. Only the first two characters of
+// each line are examined, so finding the events costs little more than
+// reading the bytes.
+class AsciiEventScanner {
+public:
+  AsciiEventScanner(char const *begin, char const *end)
+      : begin(begin), end(end) {
+    if (!Ascii::StartsWith(begin, end, "HepMC::Version", 14)) {
+      throw AsciiScannerException()
+          << "Buffer does not look like a HepMC3 Asciiv3 file.";
+    }
+    char const *second = NextLine(begin);
+    if (!Ascii::StartsWith(second, end, "HepMC::Asciiv3", 14)) {
+      throw AsciiScannerException()
+          << "Buffer does not look like a HepMC3 Asciiv3 file.";
+    }
+
+    cursor = begin;
+    while ((cursor < end) && !IsEventLine(cursor)) {
+      cursor = NextLine(cursor);
+    }
+    header_end = cursor;
+  }
+
+  // The run info, everything before the first event.
+  char const *GetHeaderBegin() const { return begin; }
+  char const *GetHeaderEnd() const { return header_end; }
+
+  // Returns false once there are no more events.
+  bool Next(RawEvent &evt) {
+    if ((cursor >= end) || !IsEventLine(cursor)) {
+      return false;
+    }
+
+    evt.begin = cursor;
+    char const *p = cursor + 1;
+    long evnum = 0;
+    Ascii::ParseInt(p, end, evnum);
+    evt.evnum = int(evnum);
+
+    p = NextLine(cursor);
+    while ((p < end) && !IsEventLine(p) && (*p != 'H')) {
+      p = NextLine(p);
+    }
+    evt.end = p;
+    cursor = p;
+    return true;
+  }
+
+  // The offset of the next event from the start of the buffer.
+  size_t GetOffset() const { return size_t(cursor - begin); }
+
+  // Continues scanning from offset, which must be the start of an event, the
+  // start of the footer or the end of the buffer, e.g. a previous
+  // GetOffset(). Returns false, leaving the scanner unchanged, otherwise.
+  bool Seek(size_t offset) {
+    if ((offset < GetHeaderEndOffset()) || (offset > size_t(end - begin))) {
+      return false;
+    }
+    char const *p = begin + offset;
+    if ((p < end) && !IsEventLine(p) && !IsFooterLine(p)) {
+      return false;
+    }
+    cursor = p;
+    return true;
+  }
+
+  // True once Next has reached the Asciiv3 footer. A file that is still
+  // being written has no footer, and its last event may be incomplete.
+  bool AtFooter() const { return (cursor < end) && IsFooterLine(cursor); }
+
+private:
+  char const *begin;
+  char const *end;
+  char const *header_end;
+  char const *cursor;
+
+  bool IsEventLine(char const *p) const {
+    return ((end - p) > 1) && (p[0] == 'E') && (p[1] == ' ');
+  }
+
+  bool IsFooterLine(char const *p) const {
+    return Ascii::StartsWith(p, end, "HepMC::Asciiv3-END_EVENT_LISTING", 32);
+  }
+
+  size_t GetHeaderEndOffset() const { return size_t(header_end - begin); }
+
+  char const *NextLine(char const *p) const {
+    auto eol = static_cast<char const *>(std::memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+  }
+};
+
+} // namespace NuHepMC
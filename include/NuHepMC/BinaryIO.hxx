@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <ios>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace NuHepMC {
+
+// Reading and writing of the sidecar files that save state between runs, such
+// as event indices and validation checkpoints. Values are written in the byte
+// order of the machine, so the files are not portable between architectures.
+// Reads do not throw, a short or malformed read leaves the stream failed and
+// the caller checks it once all of the fields have been read.
+namespace BinaryIO {
+
+template <typename T> void WritePOD(std::ostream &os, T const &v) {
+  os.write(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <typename T> T ReadPOD(std::istream &is) {
+  T v{};
+  is.read(reinterpret_cast<char *>(&v), sizeof(T));
+  return v;
+}
+
+inline void WriteString(std::ostream &os, std::string const &str) {
+  WritePOD(os, uint64_t(str.size()));
+  os.write(str.data(), str.size());
+}
+
+inline std::string ReadString(std::istream &is) {
+  uint64_t len = ReadPOD<uint64_t>(is);
+  // guard against allocating for a corrupt length
+  if (!is || (len > (uint64_t(1) << 24))) {
+    is.setstate(std::ios::failbit);
+    return std::string();
+  }
+  std::string str(len, '\0');
+  is.read(&str[0], len);
+  return str;
+}
+
+} // namespace BinaryIO
+} // namespace NuHepMC
@@ -0,0 +1,864 @@
+#pragma once
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/BinaryIO.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/WriterUtils.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/FourVector.h"
+#include "HepMC3/GenCrossSection.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/GenVertex.h"
+#include "HepMC3/Reader.h"
+#include "HepMC3/ReaderAscii.h"
+#include "HepMC3/Units.h"
+#include "HepMC3/Writer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef NuHepMC_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(ColumnarException);
+
+// A column-oriented, memory-mappable representation of a NuHepMC event file
+// for analyses that only need a few quantities from each event.
+//
+// Events are stored in blocks of up to a fixed number of events. Within a
+// block every quantity is a contiguous array, a column: event-level
+// quantities hold one entry per event, particle and vertex quantities are
+// flattened over the events of the block and are delimited by the per-event
+// offsets in particles.offsets and vertices.offsets. The topology is kept as
+// the index, within its event, of the production and end vertex of each
+// particle, or -1.
+//
+// Layout, all integers in host (little-endian) byte order:
+//   "NuHepCol" u32:version u32:0 u64:header_size <Asciiv3 run info header>
+//   <column chunks, each starting on an 8 byte boundary>
+//   <directory> u64:directory_offset "NuHepCol"
+//
+// The run info is carried as the text that HepMC3::WriterAscii writes ahead
+// of the first event, so that it round-trips through the same code as an
+// Asciiv3 file. Uncompressed columns are read in place from the mapping,
+// compressed columns (zlib, only when built with NuHepMC_USE_ZLIB) are
+// inflated the first time that they are asked for.
+namespace Columnar {
+
+enum class Type : uint8_t { kInt32 = 0, kInt64 = 1, kFloat64 = 2 };
+enum class Codec : uint8_t { kNone = 0, kZlib = 1 };
+
+inline size_t SizeOf(Type type) {
+  return (type == Type::kInt32) ? sizeof(int32_t) : 8;
+}
+
+template <typename T> struct TypeOf;
+template <> struct TypeOf<int32_t> {
+  static constexpr Type value = Type::kInt32;
+};
+template <> struct TypeOf<int64_t> {
+  static constexpr Type value = Type::kInt64;
+};
+template <> struct TypeOf<double> {
+  static constexpr Type value = Type::kFloat64;
+};
+
+inline bool HasZlib() {
+#ifdef NuHepMC_USE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Bits of the present column, set for each optional event attribute that the
+// event had.
+namespace Present {
+const int32_t kProcID = 1 << 0;
+const int32_t kLabPos = 1 << 1;
+const int32_t kTotXS = 1 << 2;
+const int32_t kProcXS = 1 << 3;
+const int32_t kCrossSection = 1 << 4;
+} // namespace Present
+
+// The columns written for every block, in file order.
+enum ColumnID : size_t {
+  // one entry per event
+  kEvNum,
+  kPresent,
+  kProcID,
+  kTotXS,
+  kProcXS,
+  kCrossSection,
+  kCrossSectionError,
+  // one entry per event plus a leading 0, offsets into the flattened columns
+  kLabPosOffsets,
+  kWeightsOffsets,
+  kParticlesOffsets,
+  kVerticesOffsets,
+  // flattened over the events of the block
+  kLabPos,
+  kWeights,
+  kParticlePID,
+  kParticleStatus,
+  kParticlePx,
+  kParticlePy,
+  kParticlePz,
+  kParticleE,
+  kParticleMass,
+  kParticleProductionVertex,
+  kParticleEndVertex,
+  kVertexStatus,
+  kVertexX,
+  kVertexY,
+  kVertexZ,
+  kVertexT,
+  kNColumns
+};
+
+struct ColumnDef {
+  char const *name;
+  Type type;
+};
+
+inline ColumnDef const &GetColumnDef(ColumnID id) {
+  static const ColumnDef defs[kNColumns] = {
+      {"evnum", Type::kInt32},
+      {"present", Type::kInt32},
+      {"ProcID", Type::kInt32},
+      {"TotXS", Type::kFloat64},
+      {"ProcXS", Type::kFloat64},
+      {"GenCrossSection.xsec", Type::kFloat64},
+      {"GenCrossSection.xsec_err", Type::kFloat64},
+      {"LabPos.offsets", Type::kInt64},
+      {"weights.offsets", Type::kInt64},
+      {"particles.offsets", Type::kInt64},
+      {"vertices.offsets", Type::kInt64},
+      {"LabPos", Type::kFloat64},
+      {"weights", Type::kFloat64},
+      {"particle.pid", Type::kInt32},
+      {"particle.status", Type::kInt32},
+      {"particle.px", Type::kFloat64},
+      {"particle.py", Type::kFloat64},
+      {"particle.pz", Type::kFloat64},
+      {"particle.e", Type::kFloat64},
+      {"particle.mass", Type::kFloat64},
+      {"particle.production_vertex", Type::kInt32},
+      {"particle.end_vertex", Type::kInt32},
+      {"vertex.status", Type::kInt32},
+      {"vertex.x", Type::kFloat64},
+      {"vertex.y", Type::kFloat64},
+      {"vertex.z", Type::kFloat64},
+      {"vertex.t", Type::kFloat64},
+  };
+  return defs[id];
+}
+
+// A read-only view of a column, valid for the lifetime of the File that it
+// came from.
+template <typename T> class Span {
+public:
+  Span() = default;
+  Span(T const *data, size_t size) : data_(data), size_(size) {}
+
+  T const *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+  T const &operator[](size_t i) const { return data_[i]; }
+  T const *begin() const { return data_; }
+  T const *end() const { return data_ + size_; }
+
+private:
+  T const *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+constexpr char kMagic[8] = {'N', 'u', 'H', 'e', 'p', 'C', 'o', 'l'};
+constexpr uint32_t kVersion = 1;
+
+// Reads a T from [p, end) and advances p, throws if the buffer is too short.
+template <typename T> T ReadPOD(char const *&p, char const *end) {
+  if (size_t(end - p) < sizeof(T)) {
+    throw ColumnarException() << "Unexpected end of columnar file directory.";
+  }
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+  return v;
+}
+
+// Where a column of a block is stored in the file.
+struct ColumnEntry {
+  std::string name;
+  Type type;
+  Codec codec;
+  uint64_t offset;
+  uint64_t stored_size;
+  uint64_t count;
+};
+
+struct BlockEntry {
+  uint64_t first_event;
+  uint64_t nevents;
+  std::vector<ColumnEntry> columns;
+};
+
+// The columns of one block that BuildEvent needs.
+struct EventColumns {
+  Span<int32_t> evnum, present, ProcID;
+  Span<double> TotXS, ProcXS, xsec, xsec_err;
+  Span<int64_t> LabPos_offsets, weights_offsets, particles_offsets,
+      vertices_offsets;
+  Span<double> LabPos, weights;
+  Span<int32_t> pid, status, production_vertex, end_vertex;
+  Span<double> px, py, pz, e, mass;
+  Span<int32_t> vertex_status;
+  Span<double> x, y, z, t;
+};
+
+// A mapped columnar file. Column access is thread-safe.
+class File {
+public:
+  explicit File(std::string const &filename)
+      : filename(filename), mapped(OpenMapped(filename)) {
+    char const *begin = mapped->begin();
+    char const *end = mapped->end();
+
+    char const *p = begin;
+    if ((mapped->GetSize() < (2 * sizeof(kMagic))) ||
+        std::memcmp(p, kMagic, sizeof(kMagic)) ||
+        std::memcmp(end - sizeof(kMagic), kMagic, sizeof(kMagic))) {
+      throw ColumnarException()
+          << filename << " is not a complete NuHepMC columnar file.";
+    }
+    p += sizeof(kMagic);
+    uint32_t version = ReadPOD<uint32_t>(p, end);
+    if (version != kVersion) {
+      throw ColumnarException()
+          << filename << " has unsupported version " << version;
+    }
+    ReadPOD<uint32_t>(p, end);
+    uint64_t header_size = ReadPOD<uint64_t>(p, end);
+    if (header_size > uint64_t(end - p)) {
+      throw ColumnarException() << filename << " is truncated.";
+    }
+    header.assign(p, header_size);
+
+    char const *trailer = end - sizeof(kMagic) - sizeof(uint64_t);
+    p = trailer;
+    uint64_t directory_offset = ReadPOD<uint64_t>(p, end);
+    if (directory_offset > uint64_t(trailer - begin)) {
+      throw ColumnarException() << filename << " has a corrupt directory.";
+    }
+    ReadDirectory(begin + directory_offset, trailer);
+
+    std::stringstream ss(header + kAsciiv3Footer);
+    HepMC3::ReaderAscii reader(ss);
+    HepMC3::GenEvent evt;
+    reader.read_event(evt);
+    run_info = reader.run_info();
+    if (!run_info) {
+      throw ColumnarException() << filename << " has no GenRunInfo.";
+    }
+  }
+
+  File(File const &) = delete;
+  File &operator=(File const &) = delete;
+
+  std::string const &GetFilename() const { return filename; }
+  std::shared_ptr<HepMC3::GenRunInfo> GetRunInfo() const { return run_info; }
+  // The Asciiv3 text of the run info.
+  std::string const &GetHeader() const { return header; }
+  HepMC3::Units::MomentumUnit GetMomentumUnit() const { return momentum_unit; }
+  HepMC3::Units::LengthUnit GetLengthUnit() const { return length_unit; }
+
+  size_t NEvents() const { return nevents; }
+  size_t NBlocks() const { return blocks.size(); }
+  BlockEntry const &GetBlock(size_t b) const { return blocks[b]; }
+
+  ColumnEntry const *FindColumn(size_t b, std::string const &name) const {
+    for (auto const &col : blocks[b].columns) {
+      if (col.name == name) {
+        return &col;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns column name of block b, throws if it does not exist or does not
+  // hold Ts. Only this column is read, or inflated if it is compressed.
+  template <typename T>
+  Span<T> Column(size_t b, std::string const &name) const {
+    ColumnEntry const *col = FindColumn(b, name);
+    if (!col) {
+      throw ColumnarException()
+          << filename << " has no column " << name << " in block " << b;
+    }
+    if (col->type != TypeOf<T>::value) {
+      throw ColumnarException()
+          << "Column " << name << " of " << filename
+          << " does not hold the requested type.";
+    }
+    return Span<T>(reinterpret_cast<T const *>(Data(b, *col)), col->count);
+  }
+
+  template <typename T> Span<T> Column(size_t b, ColumnID id) const {
+    return Column<T>(b, GetColumnDef(id).name);
+  }
+
+  EventColumns GetEventColumns(size_t b) const {
+    EventColumns c;
+    c.evnum = Column<int32_t>(b, kEvNum);
+    c.present = Column<int32_t>(b, kPresent);
+    c.ProcID = Column<int32_t>(b, kProcID);
+    c.TotXS = Column<double>(b, kTotXS);
+    c.ProcXS = Column<double>(b, kProcXS);
+    c.xsec = Column<double>(b, kCrossSection);
+    c.xsec_err = Column<double>(b, kCrossSectionError);
+    c.LabPos_offsets = Column<int64_t>(b, kLabPosOffsets);
+    c.weights_offsets = Column<int64_t>(b, kWeightsOffsets);
+    c.particles_offsets = Column<int64_t>(b, kParticlesOffsets);
+    c.vertices_offsets = Column<int64_t>(b, kVerticesOffsets);
+    c.LabPos = Column<double>(b, kLabPos);
+    c.weights = Column<double>(b, kWeights);
+    c.pid = Column<int32_t>(b, kParticlePID);
+    c.status = Column<int32_t>(b, kParticleStatus);
+    c.px = Column<double>(b, kParticlePx);
+    c.py = Column<double>(b, kParticlePy);
+    c.pz = Column<double>(b, kParticlePz);
+    c.e = Column<double>(b, kParticleE);
+    c.mass = Column<double>(b, kParticleMass);
+    c.production_vertex = Column<int32_t>(b, kParticleProductionVertex);
+    c.end_vertex = Column<int32_t>(b, kParticleEndVertex);
+    c.vertex_status = Column<int32_t>(b, kVertexStatus);
+    c.x = Column<double>(b, kVertexX);
+    c.y = Column<double>(b, kVertexY);
+    c.z = Column<double>(b, kVertexZ);
+    c.t = Column<double>(b, kVertexT);
+    return c;
+  }
+
+  // Frees the inflated copies of the compressed columns of block b, spans
+  // into them must no longer be used.
+  void Release(size_t b) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    inflated.erase(inflated.lower_bound({b, 0}),
+                   inflated.lower_bound({b + 1, 0}));
+  }
+
+private:
+  std::string filename;
+  std::unique_ptr<MappedFile> mapped;
+  std::string header;
+  std::shared_ptr<HepMC3::GenRunInfo> run_info;
+  HepMC3::Units::MomentumUnit momentum_unit = HepMC3::Units::MEV;
+  HepMC3::Units::LengthUnit length_unit = HepMC3::Units::MM;
+  size_t nevents = 0;
+  std::vector<BlockEntry> blocks;
+
+  mutable std::mutex mutex;
+  // keyed by block and column offset
+  mutable std::map<std::pair<size_t, uint64_t>, std::vector<char>> inflated;
+
+  static std::unique_ptr<MappedFile> OpenMapped(std::string const &filename) {
+    try {
+      // Columns are visited in whatever order the analysis asks for them.
+      return std::make_unique<MappedFile>(filename, MADV_NORMAL);
+    } catch (AsciiScannerException &e) {
+      throw ColumnarException() << e.what();
+    }
+  }
+
+  void ReadDirectory(char const *p, char const *end) {
+    momentum_unit = HepMC3::Units::MomentumUnit(ReadPOD<int32_t>(p, end));
+    length_unit = HepMC3::Units::LengthUnit(ReadPOD<int32_t>(p, end));
+    uint64_t nblocks = ReadPOD<uint64_t>(p, end);
+    for (uint64_t b = 0; b < nblocks; ++b) {
+      BlockEntry block;
+      block.first_event = nevents;
+      block.nevents = ReadPOD<uint64_t>(p, end);
+      uint32_t ncolumns = ReadPOD<uint32_t>(p, end);
+      for (uint32_t i = 0; i < ncolumns; ++i) {
+        ColumnEntry col;
+        uint16_t name_size = ReadPOD<uint16_t>(p, end);
+        if (size_t(end - p) < name_size) {
+          throw ColumnarException() << filename << " has a corrupt directory.";
+        }
+        col.name.assign(p, name_size);
+        p += name_size;
+        col.type = Type(ReadPOD<uint8_t>(p, end));
+        col.codec = Codec(ReadPOD<uint8_t>(p, end));
+        col.offset = ReadPOD<uint64_t>(p, end);
+        col.stored_size = ReadPOD<uint64_t>(p, end);
+        col.count = ReadPOD<uint64_t>(p, end);
+        if ((col.offset > mapped->GetSize()) ||
+            (col.stored_size > (mapped->GetSize() - col.offset))) {
+          throw ColumnarException()
+              << "Column " << col.name << " of " << filename
+              << " lies outside of the file.";
+        }
+        if ((col.codec == Codec::kNone) &&
+            (col.stored_size != (col.count * SizeOf(col.type)))) {
+          throw ColumnarException() << "Column " << col.name << " of "
+                                    << filename << " has the wrong size.";
+        }
+        block.columns.push_back(std::move(col));
+      }
+      nevents += block.nevents;
+      blocks.push_back(std::move(block));
+    }
+  }
+
+  char const *Data(size_t b, ColumnEntry const &col) const {
+    char const *stored = mapped->begin() + col.offset;
+    if (col.codec == Codec::kNone) {
+      return stored;
+    }
+    if (col.codec != Codec::kZlib) {
+      throw ColumnarException() << "Column " << col.name << " of " << filename
+                                << " uses an unknown compression.";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &buf = inflated[{b, col.offset}];
+    if (buf.empty() && col.count) {
+#ifdef NuHepMC_USE_ZLIB
+      buf.resize(col.count * SizeOf(col.type));
+      uLongf size = uLongf(buf.size());
+      if ((uncompress(reinterpret_cast<Bytef *>(buf.data()), &size,
+                      reinterpret_cast<Bytef const *>(stored),
+                      uLong(col.stored_size)) != Z_OK) ||
+          (size != buf.size())) {
+        buf.clear();
+        throw ColumnarException() << "Failed to inflate column " << col.name
+                                  << " of " << filename;
+      }
+#else
+      throw ColumnarException()
+          << "Column " << col.name << " of " << filename
+          << " is zlib compressed, but this build has no zlib support.";
+#endif
+    }
+    return buf.data();
+  }
+};
+
+// Rebuilds event i of the block that c was taken from, as it was written.
+inline void BuildEvent(EventColumns const &c, size_t i,
+                       std::shared_ptr<HepMC3::GenRunInfo> const &run_info,
+                       HepMC3::Units::MomentumUnit momentum_unit,
+                       HepMC3::Units::LengthUnit length_unit,
+                       HepMC3::GenEvent &evt) {
+  evt.clear();
+  evt.set_run_info(run_info);
+  evt.set_units(momentum_unit, length_unit);
+  evt.set_event_number(c.evnum[i]);
+  evt.weights().assign(c.weights.begin() + c.weights_offsets[i],
+                       c.weights.begin() + c.weights_offsets[i + 1]);
+
+  int32_t present = c.present[i];
+  if (present & Present::kProcID) {
+    evt.add_attribute("ProcID",
+                      std::make_shared<HepMC3::IntAttribute>(c.ProcID[i]));
+  }
+  if (present & Present::kLabPos) {
+    evt.add_attribute("LabPos",
+                      std::make_shared<HepMC3::VectorDoubleAttribute>(
+                          std::vector<double>(
+                              c.LabPos.begin() + c.LabPos_offsets[i],
+                              c.LabPos.begin() + c.LabPos_offsets[i + 1])));
+  }
+  if (present & Present::kTotXS) {
+    evt.add_attribute("TotXS",
+                      std::make_shared<HepMC3::DoubleAttribute>(c.TotXS[i]));
+  }
+  if (present & Present::kProcXS) {
+    evt.add_attribute("ProcXS",
+                      std::make_shared<HepMC3::DoubleAttribute>(c.ProcXS[i]));
+  }
+  if (present & Present::kCrossSection) {
+    auto xs = std::make_shared<HepMC3::GenCrossSection>();
+    evt.set_cross_section(xs);
+    xs->set_cross_section(c.xsec[i], c.xsec_err[i]);
+  }
+
+  std::vector<HepMC3::GenVertexPtr> vertices;
+  for (int64_t v = c.vertices_offsets[i]; v < c.vertices_offsets[i + 1];
+       ++v) {
+    auto vtx = std::make_shared<HepMC3::GenVertex>(
+        HepMC3::FourVector{c.x[v], c.y[v], c.z[v], c.t[v]});
+    vtx->set_status(c.vertex_status[v]);
+    vertices.push_back(vtx);
+  }
+
+  // Particles are added before their vertices so that both keep the ids,
+  // and so the order, that they had in the original event.
+  for (int64_t p = c.particles_offsets[i]; p < c.particles_offsets[i + 1];
+       ++p) {
+    auto part = std::make_shared<HepMC3::GenParticle>(
+        HepMC3::FourVector{c.px[p], c.py[p], c.pz[p], c.e[p]}, c.pid[p],
+        c.status[p]);
+    part->set_generated_mass(c.mass[p]);
+    if ((c.production_vertex[p] >= 0) &&
+        (size_t(c.production_vertex[p]) < vertices.size())) {
+      vertices[c.production_vertex[p]]->add_particle_out(part);
+    }
+    if ((c.end_vertex[p] >= 0) &&
+        (size_t(c.end_vertex[p]) < vertices.size())) {
+      vertices[c.end_vertex[p]]->add_particle_in(part);
+    }
+    evt.add_particle(part);
+  }
+  for (auto &vtx : vertices) {
+    evt.add_vertex(vtx);
+  }
+}
+
+} // namespace Columnar
+
+// Writes events as a NuHepMC columnar file. Blocks of block_size events are
+// held in memory and written out as they fill. With Codec::kZlib, each column
+// that shrinks when deflated is stored compressed.
+//
+// All events must share the units of the first event.
+class ColumnarWriter : public HepMC3::Writer {
+public:
+  ColumnarWriter(std::string const &filename,
+                 std::shared_ptr<HepMC3::GenRunInfo> run_info,
+                 size_t block_size = 16384,
+                 Columnar::Codec codec = Columnar::Codec::kNone)
+      : os(filename, std::ios::binary), block_size(block_size ? block_size : 1),
+        codec(codec) {
+    if (!os) {
+      throw ColumnarException() << "Failed to open " << filename;
+    }
+    if ((codec == Columnar::Codec::kZlib) && !Columnar::HasZlib()) {
+      throw ColumnarException()
+          << "zlib compression was requested, but this build has no zlib "
+             "support.";
+    }
+    set_run_info(run_info);
+
+    std::string header = FormatAsciiv3Header(run_info);
+    os.write(Columnar::kMagic, sizeof(Columnar::kMagic));
+    BinaryIO::WritePOD(os, Columnar::kVersion);
+    BinaryIO::WritePOD(os, uint32_t(0));
+    BinaryIO::WritePOD(os, uint64_t(header.size()));
+    os << header;
+    Pad();
+
+    for (size_t i = 0; i < Columnar::kNColumns; ++i) {
+      columns[i].id = Columnar::ColumnID(i);
+    }
+    StartBlock();
+  }
+
+  ~ColumnarWriter() {
+    try {
+      close();
+    } catch (std::exception &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+    }
+  }
+
+  void write_event(HepMC3::GenEvent const &evt) override {
+    using namespace Columnar;
+    static const AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+    static const AttributeHandle<HepMC3::VectorDoubleAttribute> LabPos(
+        "LabPos");
+    static const AttributeHandle<HepMC3::DoubleAttribute> TotXS("TotXS");
+    static const AttributeHandle<HepMC3::DoubleAttribute> ProcXS("ProcXS");
+
+    if (closed) {
+      throw ColumnarException() << "write_event called after close.";
+    }
+    if (!nevents_total) {
+      momentum_unit = evt.momentum_unit();
+      length_unit = evt.length_unit();
+    } else if ((evt.momentum_unit() != momentum_unit) ||
+               (evt.length_unit() != length_unit)) {
+      throw ColumnarException()
+          << "Event " << evt.event_number()
+          << " has different units to the first event written.";
+    }
+
+    Append<int32_t>(kEvNum, evt.event_number());
+
+    int32_t present = 0;
+    auto procid = ProcID.Get(&evt);
+    present |= procid ? Present::kProcID : 0;
+    Append<int32_t>(kProcID, procid ? procid->value() : 0);
+
+    auto labpos = LabPos.Get(&evt);
+    present |= labpos ? Present::kLabPos : 0;
+    if (labpos) {
+      for (double x : labpos->value()) {
+        Append<double>(kLabPos, x);
+      }
+    }
+    AppendOffset(kLabPosOffsets, kLabPos);
+
+    auto totxs = TotXS.Get(&evt);
+    present |= totxs ? Present::kTotXS : 0;
+    Append<double>(kTotXS, totxs ? totxs->value() : 0);
+
+    auto procxs = ProcXS.Get(&evt);
+    present |= procxs ? Present::kProcXS : 0;
+    Append<double>(kProcXS, procxs ? procxs->value() : 0);
+
+    auto xs = evt.cross_section();
+    present |= xs ? Present::kCrossSection : 0;
+    Append<double>(kCrossSection, xs ? xs->xsec() : 0);
+    Append<double>(kCrossSectionError, xs ? xs->xsec_err() : 0);
+
+    Append<int32_t>(kPresent, present);
+
+    for (double w : evt.weights()) {
+      Append<double>(kWeights, w);
+    }
+    AppendOffset(kWeightsOffsets, kWeights);
+
+    // HepMC3 numbers vertices -1, -2, ... in the order that they are in the
+    // event, the root vertex that holds the beam particles is 0.
+    auto VertexIndex = [](HepMC3::ConstGenVertexPtr const &vtx) {
+      return (vtx && (vtx->id() < 0)) ? int32_t(-vtx->id() - 1) : -1;
+    };
+
+    for (auto const &part : evt.particles()) {
+      auto const &mom = part->momentum();
+      Append<int32_t>(kParticlePID, part->pid());
+      Append<int32_t>(kParticleStatus, part->status());
+      Append<double>(kParticlePx, mom.px());
+      Append<double>(kParticlePy, mom.py());
+      Append<double>(kParticlePz, mom.pz());
+      Append<double>(kParticleE, mom.e());
+      Append<double>(kParticleMass, part->generated_mass());
+      Append<int32_t>(kParticleProductionVertex,
+                      VertexIndex(part->production_vertex()));
+      Append<int32_t>(kParticleEndVertex, VertexIndex(part->end_vertex()));
+    }
+    AppendOffset(kParticlesOffsets, kParticlePID);
+
+    for (auto const &vtx : evt.vertices()) {
+      // The position as stored, position() would report the position of an
+      // ancestor for a vertex that has none.
+      auto const &pos = vtx->data().position;
+      Append<int32_t>(kVertexStatus, vtx->status());
+      Append<double>(kVertexX, pos.x());
+      Append<double>(kVertexY, pos.y());
+      Append<double>(kVertexZ, pos.z());
+      Append<double>(kVertexT, pos.t());
+    }
+    AppendOffset(kVerticesOffsets, kVertexStatus);
+
+    nevents_block++;
+    nevents_total++;
+    if (nevents_block == block_size) {
+      FlushBlock();
+      StartBlock();
+    }
+  }
+
+  bool failed() override { return !os; }
+
+  // Writes the last, partial, block and the directory.
+  void close() override {
+    if (closed) {
+      return;
+    }
+    closed = true;
+    if (nevents_block) {
+      FlushBlock();
+    }
+
+    uint64_t directory_offset = uint64_t(os.tellp());
+    BinaryIO::WritePOD(os, int32_t(momentum_unit));
+    BinaryIO::WritePOD(os, int32_t(length_unit));
+    BinaryIO::WritePOD(os, uint64_t(directory.size()));
+    for (auto const &block : directory) {
+      BinaryIO::WritePOD(os, block.nevents);
+      BinaryIO::WritePOD(os, uint32_t(block.columns.size()));
+      for (auto const &col : block.columns) {
+        BinaryIO::WritePOD(os, uint16_t(col.name.size()));
+        os << col.name;
+        BinaryIO::WritePOD(os, uint8_t(col.type));
+        BinaryIO::WritePOD(os, uint8_t(col.codec));
+        BinaryIO::WritePOD(os, col.offset);
+        BinaryIO::WritePOD(os, col.stored_size);
+        BinaryIO::WritePOD(os, col.count);
+      }
+    }
+    BinaryIO::WritePOD(os, directory_offset);
+    os.write(Columnar::kMagic, sizeof(Columnar::kMagic));
+    os.close();
+    if (!os) {
+      throw ColumnarException() << "Failed writing columnar file.";
+    }
+  }
+
+private:
+  struct ColumnBuffer {
+    Columnar::ColumnID id;
+    std::vector<char> data;
+  };
+
+  std::ofstream os;
+  size_t block_size;
+  Columnar::Codec codec;
+  ColumnBuffer columns[Columnar::kNColumns];
+  std::vector<Columnar::BlockEntry> directory;
+  size_t nevents_block = 0;
+  size_t nevents_total = 0;
+  HepMC3::Units::MomentumUnit momentum_unit = HepMC3::Units::MEV;
+  HepMC3::Units::LengthUnit length_unit = HepMC3::Units::MM;
+  bool closed = false;
+
+  template <typename T> void Append(Columnar::ColumnID id, T v) {
+    auto &data = columns[id].data;
+    char const *p = reinterpret_cast<char const *>(&v);
+    data.insert(data.end(), p, p + sizeof(T));
+  }
+
+  size_t Count(Columnar::ColumnID id) const {
+    return columns[id].data.size() /
+           Columnar::SizeOf(Columnar::GetColumnDef(id).type);
+  }
+
+  // Marks the end of the current event in the flattened column flat.
+  void AppendOffset(Columnar::ColumnID offsets, Columnar::ColumnID flat) {
+    Append<int64_t>(offsets, int64_t(Count(flat)));
+  }
+
+  void StartBlock() {
+    for (auto id : {Columnar::kLabPosOffsets, Columnar::kWeightsOffsets,
+                    Columnar::kParticlesOffsets, Columnar::kVerticesOffsets}) {
+      Append<int64_t>(id, 0);
+    }
+  }
+
+  void Pad() {
+    static const char zeros[8] = {};
+    os.write(zeros, (8 - (uint64_t(os.tellp()) % 8)) % 8);
+  }
+
+  void FlushBlock() {
+    Columnar::BlockEntry block;
+    block.first_event = nevents_total - nevents_block;
+    block.nevents = nevents_block;
+    for (auto &col : columns) {
+      auto const &def = Columnar::GetColumnDef(col.id);
+      Columnar::ColumnEntry entry{def.name,
+                                  def.type,
+                                  Columnar::Codec::kNone,
+                                  uint64_t(os.tellp()),
+                                  uint64_t(col.data.size()),
+                                  uint64_t(Count(col.id))};
+
+      char const *data = col.data.data();
+#ifdef NuHepMC_USE_ZLIB
+      std::vector<char> deflated;
+      if ((codec == Columnar::Codec::kZlib) && col.data.size()) {
+        uLongf size = compressBound(uLong(col.data.size()));
+        deflated.resize(size);
+        if (compress(reinterpret_cast<Bytef *>(deflated.data()), &size,
+                     reinterpret_cast<Bytef const *>(col.data.data()),
+                     uLong(col.data.size())) != Z_OK) {
+          throw ColumnarException() << "Failed to deflate column " << def.name;
+        }
+        if (size < col.data.size()) {
+          entry.codec = Columnar::Codec::kZlib;
+          entry.stored_size = size;
+          data = deflated.data();
+        }
+      }
+#endif
+      os.write(data, entry.stored_size);
+      Pad();
+      block.columns.push_back(std::move(entry));
+      col.data.clear();
+    }
+    if (!os) {
+      throw ColumnarException() << "Failed writing columnar file.";
+    }
+    directory.push_back(std::move(block));
+    nevents_block = 0;
+  }
+};
+
+// Reads the events of a columnar file in order, rebuilding each GenEvent
+// from the columns, so that a columnar file can be used wherever a
+// HepMC3::Reader is expected.
+class ColumnarReader : public HepMC3::Reader {
+public:
+  explicit ColumnarReader(std::string const &filename) : file(filename) {
+    set_run_info(file.GetRunInfo());
+  }
+
+  bool read_event(HepMC3::GenEvent &evt) override {
+    if (!Advance()) {
+      return false;
+    }
+    Columnar::BuildEvent(columns, next - file.GetBlock(block).first_event,
+                         run_info(), file.GetMomentumUnit(),
+                         file.GetLengthUnit(), evt);
+    next++;
+    return true;
+  }
+
+  bool skip(const int n) override {
+    next += size_t(n);
+    return Advance();
+  }
+
+  bool failed() override { return done; }
+
+  void close() override { next = file.NEvents(); }
+
+  Columnar::File const &GetFile() const { return file; }
+
+private:
+  Columnar::File file;
+  Columnar::EventColumns columns;
+  size_t block = 0;
+  bool loaded = false;
+  size_t next = 0;
+  bool done = false;
+
+  // Makes columns those of the block holding event next, returns false if
+  // there are no more events.
+  bool Advance() {
+    if (next >= file.NEvents()) {
+      done = true;
+      return false;
+    }
+    while ((next - file.GetBlock(block).first_event) >=
+           file.GetBlock(block).nevents) {
+      file.Release(block);
+      block++;
+      loaded = false;
+    }
+    if (!loaded) {
+      columns = file.GetEventColumns(block);
+      loaded = true;
+    }
+    return true;
+  }
+};
+
+} // namespace NuHepMC
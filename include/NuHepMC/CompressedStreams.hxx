@@ -0,0 +1,697 @@
+#pragma once
+
+#include "NuHepMC/EventPipeline.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/Profiling.hxx"
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/Reader.h"
+#include "HepMC3/ReaderAscii.h"
+#include "HepMC3/ReaderFactory.h"
+#include "HepMC3/Writer.h"
+#include "HepMC3/WriterAscii.h"
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef NuHepMC_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NuHepMC_USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(CompressionException);
+
+enum class Compression { kNone, kGzip, kZstd };
+
+// Selects the default level of each library, gzip 6 and zstd 3.
+const int kDefaultCompressionLevel = INT_MIN;
+
+inline std::string GetName(Compression c) {
+  switch (c) {
+  case Compression::kGzip:
+    return "gzip";
+  case Compression::kZstd:
+    return "zstd";
+  default:
+    return "uncompressed";
+  }
+}
+
+// Whether this build was linked against the library for c.
+inline bool IsSupported(Compression c) {
+  switch (c) {
+  case Compression::kGzip: {
+#ifdef NuHepMC_USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+  }
+  case Compression::kZstd: {
+#ifdef NuHepMC_USE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  }
+  default:
+    return true;
+  }
+}
+
+// Output compression is chosen by extension, .gz or .zst
+inline Compression CompressionFromExtension(std::string const &filename) {
+  auto EndsWith = [&](std::string const &ext) {
+    return (filename.size() >= ext.size()) &&
+           !filename.compare(filename.size() - ext.size(), ext.size(), ext);
+  };
+  if (EndsWith(".gz")) {
+    return Compression::kGzip;
+  }
+  if (EndsWith(".zst")) {
+    return Compression::kZstd;
+  }
+  return Compression::kNone;
+}
+
+// Input compression is recognised by the leading magic bytes, whatever the
+// file is called.
+inline Compression DetectCompression(std::string const &filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  unsigned char magic[4] = {};
+  ifs.read(reinterpret_cast<char *>(magic), sizeof(magic));
+  if ((ifs.gcount() >= 2) && (magic[0] == 0x1f) && (magic[1] == 0x8b)) {
+    return Compression::kGzip;
+  }
+  if ((ifs.gcount() == 4) && (magic[0] == 0x28) && (magic[1] == 0xb5) &&
+      (magic[2] == 0x2f) && (magic[3] == 0xfd)) {
+    return Compression::kZstd;
+  }
+  return Compression::kNone;
+}
+
+inline void ThrowUnsupported(Compression c) {
+  throw CompressionException()
+      << GetName(c) << " compression is not supported by this build.";
+}
+
+// Compresses whole blocks, each into a self-contained gzip member or zstd
+// frame. Both formats define a sequence of these to decompress to the
+// concatenation of the blocks, so the output of independent compressors can
+// simply be written one after the other. Not thread-safe, each thread needs
+// its own.
+class BlockCompressor {
+public:
+  BlockCompressor(Compression c, int level) : c(c) {
+    if (!IsSupported(c) || (c == Compression::kNone)) {
+      ThrowUnsupported(c);
+    }
+#ifdef NuHepMC_USE_ZLIB
+    if (c == Compression::kGzip) {
+      // 15 + 16: the largest window, with a gzip rather than zlib wrapper
+      if (deflateInit2(&zs,
+                       (level == kDefaultCompressionLevel)
+                           ? Z_DEFAULT_COMPRESSION
+                           : level,
+                       Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw CompressionException()
+            << "Invalid gzip compression level " << level;
+      }
+    }
+#endif
+#ifdef NuHepMC_USE_ZSTD
+    if (c == Compression::kZstd) {
+      this->level =
+          (level == kDefaultCompressionLevel) ? ZSTD_CLEVEL_DEFAULT : level;
+      if ((this->level < ZSTD_minCLevel()) ||
+          (this->level > ZSTD_maxCLevel())) {
+        throw CompressionException()
+            << "Invalid zstd compression level " << level;
+      }
+      cctx = ZSTD_createCCtx();
+    }
+#endif
+    (void)level;
+  }
+
+  BlockCompressor(BlockCompressor const &) = delete;
+  BlockCompressor &operator=(BlockCompressor const &) = delete;
+
+  ~BlockCompressor() {
+#ifdef NuHepMC_USE_ZLIB
+    if (c == Compression::kGzip) {
+      deflateEnd(&zs);
+    }
+#endif
+#ifdef NuHepMC_USE_ZSTD
+    if (cctx) {
+      ZSTD_freeCCtx(cctx);
+    }
+#endif
+  }
+
+  void Compress(std::vector<char> const &in, std::vector<char> &out) {
+    NuHepMC_PROFILE_SCOPE("Compression.Compress");
+#ifdef NuHepMC_USE_ZLIB
+    if (c == Compression::kGzip) {
+      deflateReset(&zs);
+      out.resize(deflateBound(&zs, uLong(in.size())));
+      zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+      zs.avail_in = uInt(in.size());
+      zs.next_out = reinterpret_cast<Bytef *>(out.data());
+      zs.avail_out = uInt(out.size());
+      if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        throw CompressionException() << "gzip compression failed.";
+      }
+      out.resize(zs.total_out);
+      return;
+    }
+#endif
+#ifdef NuHepMC_USE_ZSTD
+    if (c == Compression::kZstd) {
+      out.resize(ZSTD_compressBound(in.size()));
+      size_t n = ZSTD_compressCCtx(cctx, out.data(), out.size(), in.data(),
+                                   in.size(), level);
+      if (ZSTD_isError(n)) {
+        throw CompressionException()
+            << "zstd compression failed: " << ZSTD_getErrorName(n);
+      }
+      out.resize(n);
+      return;
+    }
+#endif
+    (void)in;
+    (void)out;
+    ThrowUnsupported(c);
+  }
+
+private:
+  Compression c;
+#ifdef NuHepMC_USE_ZLIB
+  z_stream zs{};
+#endif
+#ifdef NuHepMC_USE_ZSTD
+  int level = 0;
+  ZSTD_CCtx *cctx = nullptr;
+#endif
+};
+
+// A write-only stream buffer that compresses everything written to it into
+// filename. The text is cut into blocks of block_size bytes that are
+// compressed on nthreads worker threads and written to the file, in order, by
+// the thread writing to the stream. With nthreads == 0 blocks are compressed
+// inline. At most 2 * nthreads blocks are in flight at once, beyond that
+// writing to the stream blocks until the oldest block has been compressed.
+//
+// A failure makes the stream bad, and is thrown as a CompressionException
+// from Close.
+class CompressedOStreamBuf : public std::streambuf {
+public:
+  CompressedOStreamBuf(std::string const &filename, Compression c,
+                       int level = kDefaultCompressionLevel,
+                       size_t nthreads = std::thread::hardware_concurrency(),
+                       size_t block_size = 1 << 20)
+      : ofs(filename, std::ios::binary), block_size(block_size),
+        max_inflight(2 * std::max(nthreads, size_t(1))),
+        work(max_inflight) {
+    if (!ofs) {
+      throw CompressionException() << "Failed to open " << filename;
+    }
+    // Constructing the compressors checks c and level before any thread is
+    // started.
+    for (size_t i = 0; i < std::max(nthreads, size_t(1)); ++i) {
+      compressors.push_back(std::make_unique<BlockCompressor>(c, level));
+    }
+    for (size_t i = 0; i < nthreads; ++i) {
+      workers.emplace_back([this, i]() { Work(*compressors[i]); });
+    }
+    block.resize(block_size);
+    setp(block.data(), block.data() + block.size());
+  }
+
+  CompressedOStreamBuf(CompressedOStreamBuf const &) = delete;
+  CompressedOStreamBuf &operator=(CompressedOStreamBuf const &) = delete;
+
+  ~CompressedOStreamBuf() {
+    try {
+      Close();
+    } catch (std::exception &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+    }
+  }
+
+  // Compresses and writes anything still buffered and closes the file.
+  void Close() {
+    if (closed) {
+      return;
+    }
+    closed = true;
+    if (pptr() > pbase()) {
+      Submit();
+    }
+    work.Close();
+    for (auto &w : workers) {
+      w.join();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      WriteReady();
+    }
+    ofs.close();
+    if (!error && !ofs) {
+      error = std::make_exception_ptr(CompressionException()
+                                      << "Failed writing compressed output.");
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (closed || !Submit()) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  // Blocks are only cut when full, so that every block compresses as well as
+  // block_size allows regardless of how often the writer flushes.
+  int sync() override { return error ? -1 : 0; }
+
+private:
+  struct Job {
+    size_t seq;
+    std::vector<char> data;
+  };
+
+  std::ofstream ofs;
+  size_t block_size;
+  size_t max_inflight;
+  std::vector<std::unique_ptr<BlockCompressor>> compressors;
+  std::vector<std::thread> workers;
+  BoundedQueue<Job> work;
+  std::vector<char> block;
+  bool closed = false;
+
+  std::mutex mutex;
+  std::condition_variable done;
+  std::map<size_t, std::vector<char>> compressed;
+  std::vector<std::vector<char>> spare;
+  size_t nsubmitted = 0;
+  size_t nwritten = 0;
+  std::exception_ptr error;
+
+  void Work(BlockCompressor &compressor) {
+    Job job;
+    while (work.Pop(job)) {
+      std::vector<char> out;
+      std::exception_ptr e;
+      try {
+        compressor.Compress(job.data, out);
+      } catch (...) {
+        e = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (e && !error) {
+        error = e;
+      }
+      compressed[job.seq] = std::move(out);
+      spare.push_back(std::move(job.data));
+      done.notify_all();
+    }
+  }
+
+  // Writes the compressed blocks that are next in line, the caller must hold
+  // mutex.
+  void WriteReady() {
+    for (auto it = compressed.find(nwritten); it != compressed.end();
+         it = compressed.find(nwritten)) {
+      ofs.write(it->second.data(), it->second.size());
+      compressed.erase(it);
+      nwritten++;
+    }
+  }
+
+  // Hands the filled part of the current block over for compression and
+  // starts a new one. Returns false once anything has failed.
+  bool Submit() {
+    block.resize(pptr() - pbase());
+    NuHepMC_PROFILE_COUNT("Output.UncompressedBytes", block.size());
+    if (workers.empty()) {
+      std::vector<char> out;
+      try {
+        compressors.front()->Compress(block, out);
+      } catch (...) {
+        error = std::current_exception();
+        return false;
+      }
+      ofs.write(out.data(), out.size());
+    } else {
+      std::vector<char> next;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() {
+          WriteReady();
+          return error || ((nsubmitted - nwritten) < max_inflight);
+        });
+        if (error) {
+          return false;
+        }
+        if (spare.size()) {
+          next = std::move(spare.back());
+          spare.pop_back();
+        }
+      }
+      work.Push(Job{nsubmitted++, std::move(block)});
+      block = std::move(next);
+    }
+    block.resize(block_size);
+    setp(block.data(), block.data() + block.size());
+    return bool(ofs);
+  }
+};
+
+// A read-only stream buffer over a compressed file, which is read and
+// decompressed on a background thread while the previous block_size bytes of
+// text are being consumed. Neither format can be split for parallel
+// decompression without an index, but overlapping decompression with parsing
+// takes it off the critical path.
+//
+// Corrupt or truncated input ends the stream early, ThrowIfFailed then throws
+// the reason as a CompressionException.
+class DecompressingIStreamBuf : public std::streambuf {
+public:
+  DecompressingIStreamBuf(std::string const &filename, Compression c,
+                          size_t block_size = 1 << 20)
+      : ifs(filename, std::ios::binary), c(c), block_size(block_size),
+        blocks(4) {
+    if (!ifs) {
+      throw CompressionException() << "Failed to open " << filename;
+    }
+    if (!IsSupported(c) || (c == Compression::kNone)) {
+      ThrowUnsupported(c);
+    }
+    thread = std::thread([this]() { Run(); });
+  }
+
+  DecompressingIStreamBuf(DecompressingIStreamBuf const &) = delete;
+  DecompressingIStreamBuf &operator=(DecompressingIStreamBuf const &) = delete;
+
+  ~DecompressingIStreamBuf() {
+    blocks.Close();
+    thread.join();
+  }
+
+  void ThrowIfFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // The number of decompressed bytes handed to the reader so far. Only to be
+  // called from the reading thread.
+  uint64_t GetNBytesRead() const { return nbytes_read; }
+
+protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+    {
+      NuHepMC_PROFILE_SCOPE("Input.WaitForDecompression");
+      if (!blocks.Pop(current)) {
+        return traits_type::eof();
+      }
+    }
+    NuHepMC_PROFILE_COUNT("Input.DecompressedBytes", current.size());
+    nbytes_read += current.size();
+    setg(current.data(), current.data(), current.data() + current.size());
+    return traits_type::to_int_type(*gptr());
+  }
+
+private:
+  std::ifstream ifs;
+  Compression c;
+  size_t block_size;
+  BoundedQueue<std::vector<char>> blocks;
+  std::vector<char> current;
+  uint64_t nbytes_read = 0;
+  std::thread thread;
+
+  mutable std::mutex mutex;
+  std::exception_ptr error;
+
+  void Run() {
+    try {
+      Decompress();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      error = std::current_exception();
+    }
+    blocks.Close();
+  }
+
+  // Feeds the file through f(in, nin, nread, out, nout), which decompresses
+  // some of the nin bytes at in, setting nread to how many, into out and
+  // returns the number of bytes written there. Full output blocks are handed
+  // to the stream. f is called until it has consumed each chunk read from the
+  // file and, after filling a block, once more to drain any output that it
+  // held back.
+  template <typename F> void ForEachChunk(F const &f) {
+    std::vector<char> in(block_size);
+    std::vector<char> out(block_size);
+    size_t filled = 0;
+    for (;;) {
+      ifs.read(in.data(), in.size());
+      size_t nin = size_t(ifs.gcount());
+      if (!nin) {
+        break;
+      }
+      char const *next_in = in.data();
+      bool full;
+      do {
+        size_t nread = 0;
+        filled += f(next_in, nin, nread, out.data() + filled,
+                    out.size() - filled);
+        next_in += nread;
+        nin -= nread;
+        full = (filled == out.size());
+        if (full) {
+          if (!blocks.Push(std::move(out))) {
+            // the reader has gone away
+            return;
+          }
+          out.assign(block_size, 0);
+          filled = 0;
+        }
+      } while (nin || full);
+    }
+    out.resize(filled);
+    if (filled) {
+      blocks.Push(std::move(out));
+    }
+  }
+
+  void Decompress() {
+#ifdef NuHepMC_USE_ZLIB
+    if (c == Compression::kGzip) {
+      z_stream zs{};
+      // 15 + 32: the largest window, with either wrapper detected
+      if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        throw CompressionException() << "Failed to initialise zlib.";
+      }
+      std::unique_ptr<z_stream, int (*)(z_streamp)> guard(&zs, inflateEnd);
+      bool in_member = false;
+      ForEachChunk([&](char const *in, size_t nin, size_t &nread, char *out,
+                       size_t nout) {
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+        zs.avail_in = uInt(nin);
+        zs.next_out = reinterpret_cast<Bytef *>(out);
+        zs.avail_out = uInt(nout);
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+          // a file may hold many members, e.g. from CompressedOStreamBuf
+          inflateReset(&zs);
+          in_member = false;
+        } else if ((ret == Z_OK) || ((ret == Z_BUF_ERROR) && !nin)) {
+          in_member = in_member || (zs.avail_in < nin);
+        } else {
+          throw CompressionException()
+              << "Corrupt gzip input: " << (zs.msg ? zs.msg : "unknown");
+        }
+        nread = nin - zs.avail_in;
+        return nout - zs.avail_out;
+      });
+      if (in_member) {
+        throw CompressionException() << "Truncated gzip input.";
+      }
+      return;
+    }
+#endif
+#ifdef NuHepMC_USE_ZSTD
+    if (c == Compression::kZstd) {
+      std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> dctx(
+          ZSTD_createDCtx(), ZSTD_freeDCtx);
+      size_t pending = 0;
+      ForEachChunk([&](char const *in, size_t nin, size_t &nread, char *out,
+                       size_t nout) {
+        ZSTD_inBuffer ib{in, nin, 0};
+        ZSTD_outBuffer ob{out, nout, 0};
+        size_t ret = ZSTD_decompressStream(dctx.get(), &ob, &ib);
+        if (ZSTD_isError(ret)) {
+          throw CompressionException()
+              << "Corrupt zstd input: " << ZSTD_getErrorName(ret);
+        }
+        // 0 once a frame is complete and fully flushed
+        pending = ret;
+        nread = ib.pos;
+        return ob.pos;
+      });
+      if (pending) {
+        throw CompressionException() << "Truncated zstd input.";
+      }
+      return;
+    }
+#endif
+    ThrowUnsupported(c);
+  }
+};
+
+// Reads an Asciiv3 file through a DecompressingIStreamBuf. A decompression
+// failure is thrown from read_event as a CompressionException rather than
+// being mistaken for the end of the file.
+class CompressedReaderAscii : public HepMC3::Reader {
+public:
+  CompressedReaderAscii(std::string const &filename, Compression c)
+      : buf(filename, c), is(&buf), reader(is) {
+    set_run_info(reader.run_info());
+  }
+
+  bool read_event(HepMC3::GenEvent &evt) override {
+    bool ok = reader.read_event(evt);
+    set_run_info(reader.run_info());
+    if (reader.failed()) {
+      buf.ThrowIfFailed();
+    }
+    return ok;
+  }
+
+  bool skip(const int n) override {
+    bool ok = reader.skip(n);
+    if (reader.failed()) {
+      buf.ThrowIfFailed();
+    }
+    return ok;
+  }
+
+  bool failed() override { return reader.failed(); }
+  void close() override { reader.close(); }
+
+  // The number of bytes of Asciiv3 text decompressed and read so far.
+  uint64_t GetNBytesRead() const { return buf.GetNBytesRead(); }
+
+private:
+  DecompressingIStreamBuf buf;
+  std::istream is;
+  HepMC3::ReaderAscii reader;
+};
+
+// Writes an Asciiv3 file through a CompressedOStreamBuf.
+class CompressedWriterAscii : public HepMC3::Writer {
+public:
+  CompressedWriterAscii(std::string const &filename,
+                        std::shared_ptr<HepMC3::GenRunInfo> run_info,
+                        Compression c, int level = kDefaultCompressionLevel,
+                        size_t nthreads = std::thread::hardware_concurrency())
+      : buf(filename, c, level, nthreads), os(&buf), writer(os, run_info) {
+    set_run_info(run_info);
+  }
+
+  ~CompressedWriterAscii() {
+    try {
+      close();
+    } catch (std::exception &e) {
+      std::cout << "[ERROR]: " << e.what() << std::endl;
+    }
+  }
+
+  void write_event(HepMC3::GenEvent const &evt) override {
+    writer.write_event(evt);
+  }
+
+  bool failed() override { return writer.failed() || !os; }
+
+  // Throws CompressionException if any of the output could not be written.
+  void close() override {
+    if (closed) {
+      return;
+    }
+    closed = true;
+    writer.close();
+    buf.Close();
+  }
+
+private:
+  CompressedOStreamBuf buf;
+  std::ostream os;
+  HepMC3::WriterAscii writer;
+  bool closed = false;
+};
+
+// Opens filename with the reader that suits it: compressed files, whatever
+// their name, are read as Asciiv3 through a CompressedReaderAscii, anything
+// else is left to HepMC3::deduce_reader.
+inline std::shared_ptr<HepMC3::Reader> OpenReader(std::string const &filename) {
+  auto c = DetectCompression(filename);
+  if (c == Compression::kNone) {
+    return HepMC3::deduce_reader(filename);
+  }
+  if (!IsSupported(c)) {
+    throw CompressionException()
+        << filename << " is " << GetName(c)
+        << " compressed, which is not supported by this build.";
+  }
+  return std::make_shared<CompressedReaderAscii>(filename, c);
+}
+
+// An Asciiv3 writer for filename, compressed according to its extension.
+inline std::shared_ptr<HepMC3::Writer>
+OpenWriterAscii(std::string const &filename,
+                std::shared_ptr<HepMC3::GenRunInfo> run_info,
+                int level = kDefaultCompressionLevel,
+                size_t nthreads = std::thread::hardware_concurrency()) {
+  auto c = CompressionFromExtension(filename);
+  if (c == Compression::kNone) {
+    return std::make_shared<HepMC3::WriterAscii>(filename, run_info);
+  }
+  return std::make_shared<CompressedWriterAscii>(filename, run_info, c, level,
+                                                 nthreads);
+}
+
+} // namespace NuHepMC
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/FourVector.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/GenVertex.h"
+#include "HepMC3/Units.h"
+
+#include "NuHepMC/Constants.hxx"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+// Recycles fixed-size blocks of memory through one free list per block size.
+// Blocks are only returned to the system when the pool is destroyed.
+//
+// Blocks may be freed on a different thread to the one that allocated them,
+// e.g. when events are written by an AsyncWriter.
+class BlockPool {
+public:
+  BlockPool() = default;
+  BlockPool(BlockPool const &) = delete;
+  BlockPool &operator=(BlockPool const &) = delete;
+
+  ~BlockPool() {
+    for (auto &fl : free_lists) {
+      while (fl.head) {
+        FreeBlock *next = fl.head->next;
+        ::operator delete(fl.head);
+        fl.head = next;
+      }
+    }
+  }
+
+  void *Allocate(size_t size) {
+    size = std::max(size, sizeof(FreeBlock));
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      FreeList &fl = GetFreeList(size);
+      if (fl.head) {
+        FreeBlock *block = fl.head;
+        fl.head = block->next;
+        fl.nfree--;
+        return block;
+      }
+      fl.nallocated++;
+    }
+    return ::operator new(size);
+  }
+
+  // The free list for size always exists by the time a block of that size is
+  // returned, so this never allocates.
+  void Deallocate(void *p, size_t size) noexcept {
+    size = std::max(size, sizeof(FreeBlock));
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &fl : free_lists) {
+      if (fl.size == size) {
+        fl.head = new (p) FreeBlock{fl.head};
+        fl.nfree++;
+        return;
+      }
+    }
+  }
+
+  // The number of blocks obtained from the system, and how many of those are
+  // currently free.
+  size_t NAllocated() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = 0;
+    for (auto const &fl : free_lists) {
+      n += fl.nallocated;
+    }
+    return n;
+  }
+  size_t NFree() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = 0;
+    for (auto const &fl : free_lists) {
+      n += fl.nfree;
+    }
+    return n;
+  }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+  struct FreeList {
+    size_t size;
+    FreeBlock *head;
+    size_t nallocated;
+    size_t nfree;
+  };
+
+  // Only a handful of object types are pooled, so a linear search is quicker
+  // than a map.
+  std::vector<FreeList> free_lists;
+  mutable std::mutex mutex;
+
+  FreeList &GetFreeList(size_t size) {
+    for (auto &fl : free_lists) {
+      if (fl.size == size) {
+        return fl;
+      }
+    }
+    free_lists.push_back(FreeList{size, nullptr, 0, 0});
+    return free_lists.back();
+  }
+};
+
+// A standard allocator over a shared BlockPool. Objects created with
+// std::allocate_shared keep a copy of the allocator, and so the pool, alive
+// in their control block until they are destroyed.
+template <typename T> class PoolAllocator {
+public:
+  using value_type = T;
+
+  explicit PoolAllocator(std::shared_ptr<BlockPool> pool)
+      : pool(std::move(pool)) {}
+  template <typename U>
+  PoolAllocator(PoolAllocator<U> const &other) : pool(other.pool) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(pool->Allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) noexcept {
+    pool->Deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U> bool operator==(PoolAllocator<U> const &other) const {
+    return pool == other.pool;
+  }
+  template <typename U> bool operator!=(PoolAllocator<U> const &other) const {
+    return pool != other.pool;
+  }
+
+private:
+  template <typename U> friend class PoolAllocator;
+  std::shared_ptr<BlockPool> pool;
+};
+
+// Builds events from pooled particles, vertices and attributes so that a
+// long-running writer stops allocating fresh memory for every object of every
+// event.
+//
+// Each object is still constructed anew: HepMC3 records which event a
+// particle or vertex belongs to and will not add one that is already in an
+// event, and an event that has been handed to an AsyncWriter may still be
+// waiting to be written. It is the memory that is recycled, once every
+// reference to an object has gone.
+//
+// The helpers set the NuHepMC-required event content in the same way as the
+// hand-written equivalents, so switching to them does not change the output.
+class EventBuilder {
+public:
+  explicit EventBuilder(
+      std::shared_ptr<HepMC3::GenRunInfo> run_info,
+      HepMC3::Units::MomentumUnit momentum_unit = HepMC3::Units::MEV,
+      HepMC3::Units::LengthUnit length_unit = HepMC3::Units::MM)
+      : run_info(std::move(run_info)), momentum_unit(momentum_unit),
+        length_unit(length_unit), pool(std::make_shared<BlockPool>()) {}
+
+  // Leaves evt as a GenEvent(run_info, momentum_unit, length_unit) would be,
+  // but keeping the capacity of its containers. E.R.3
+  void Reset(HepMC3::GenEvent &evt) const {
+    evt.clear();
+    evt.set_run_info(run_info);
+    evt.set_units(momentum_unit, length_unit);
+    evt.weights().assign(run_info ? run_info->weight_names().size() : 0, 1);
+  }
+
+  // Constructs a T from the pool.
+  template <typename T, typename... Args>
+  std::shared_ptr<T> Make(Args &&...args) const {
+    return std::allocate_shared<T>(PoolAllocator<T>(pool),
+                                   std::forward<Args>(args)...);
+  }
+
+  HepMC3::GenParticlePtr Particle(HepMC3::FourVector const &momentum, int pid,
+                                  int status) const {
+    return Make<HepMC3::GenParticle>(momentum, pid, status);
+  }
+
+  HepMC3::GenVertexPtr Vertex(HepMC3::FourVector const &position,
+                              int status) const {
+    auto vtx = Make<HepMC3::GenVertex>(position);
+    vtx->set_status(status);
+    return vtx;
+  }
+
+  // E.R.5
+  HepMC3::GenVertexPtr
+  PrimaryVertex(HepMC3::FourVector const &position = HepMC3::FourVector{})
+      const {
+    return Vertex(position, VertexStatus::kPrimaryVertex);
+  }
+
+  // E.R.6
+  HepMC3::GenParticlePtr BeamParticle(HepMC3::FourVector const &momentum,
+                                      int pid) const {
+    return Particle(momentum, pid, ParticleStatus::kIncomingBeamParticle);
+  }
+
+  // E.R.2
+  void SetProcID(HepMC3::GenEvent &evt, int ProcID) const {
+    evt.add_attribute("ProcID", Make<HepMC3::IntAttribute>(ProcID));
+  }
+
+  // E.R.4
+  void SetLabPos(HepMC3::GenEvent &evt,
+                 std::vector<double> const &LabPos) const {
+    evt.add_attribute("LabPos", Make<HepMC3::VectorDoubleAttribute>(LabPos));
+  }
+
+  // E.C.1
+  void SetCVWeight(HepMC3::GenEvent &evt, double weight) const {
+    evt.weight("CV") = weight;
+  }
+
+  // E.C.2
+  void SetTotXS(HepMC3::GenEvent &evt, double TotXS) const {
+    evt.add_attribute("TotXS", Make<HepMC3::DoubleAttribute>(TotXS));
+  }
+
+  // E.C.3
+  void SetProcXS(HepMC3::GenEvent &evt, double ProcXS) const {
+    evt.add_attribute("ProcXS", Make<HepMC3::DoubleAttribute>(ProcXS));
+  }
+
+  BlockPool const &GetPool() const { return *pool; }
+
+private:
+  std::shared_ptr<HepMC3::GenRunInfo> run_info;
+  HepMC3::Units::MomentumUnit momentum_unit;
+  HepMC3::Units::LengthUnit length_unit;
+  std::shared_ptr<BlockPool> pool;
+};
+
+} // namespace NuHepMC
@@ -0,0 +1,393 @@
+#pragma once
+
+#include "NuHepMC/BinaryIO.hxx"
+#include "NuHepMC/Exceptions.hxx"
+
+#include "HepMC3/ReaderAscii.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(EventIndexException);
+
+// FNV-1a, used to fingerprint file contents.
+inline uint64_t HashBytes(char const *data, size_t len,
+                          uint64_t hash = 0xcbf29ce484222325ull) {
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Byte offsets of the events in an Asciiv3 file, along with their event
+// numbers and ProcIDs, so that any event can be reached without parsing those
+// before it and so that a file can be split into independent ranges of whole
+// events.
+//
+// The index is built with a single scan that only looks at the first
+// characters of each line, and can be saved to a sidecar file
+// (GetSidecarName) and checked against the file with IsValidFor before it is
+// reused. The index stores hashes of the header and of the E line of every
+// event, so checking it reads only those lines rather than the whole file.
+class EventIndex {
+public:
+  // Used as the ProcID of events without a ProcID attribute.
+  static constexpr int kNoProcID = std::numeric_limits<int>::min();
+
+  struct Entry {
+    uint64_t offset;
+    int evnum;
+    int ProcID;
+  };
+
+  static std::string GetSidecarName(std::string const &filename) {
+    return filename + ".nuhepmcidx";
+  }
+
+  static EventIndex Build(std::string const &filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+      throw EventIndexException() << "Failed to open " << filename;
+    }
+    std::vector<char> iobuf(1 << 20);
+    ifs.rdbuf()->pubsetbuf(iobuf.data(), iobuf.size());
+
+    EventIndex idx;
+    idx.header_hash = HashBytes(nullptr, 0);
+    idx.lines_hash = HashBytes(nullptr, 0);
+
+    std::string line;
+    uint64_t offset = 0;
+    bool in_header = true;
+    size_t nline = 0;
+    while (std::getline(ifs, line)) {
+      uint64_t line_offset = offset;
+      // The last line of the file may not end in a newline
+      bool const has_newline = !ifs.eof();
+      offset += line.size() + has_newline;
+
+      if (nline < 2) {
+        if (line.compare(0, 14, nline ? "HepMC::Asciiv3" : "HepMC::Version")) {
+          throw EventIndexException()
+              << filename << " does not look like a HepMC3 Asciiv3 file.";
+        }
+        nline++;
+      }
+
+      if (line.compare(0, 2, "E ") == 0) {
+        if (in_header) {
+          in_header = false;
+          idx.header_end = line_offset;
+        }
+        idx.entries.push_back(Entry{
+            line_offset, int(std::strtol(line.c_str() + 2, nullptr, 10)),
+            kNoProcID});
+        idx.lines_hash = HashBytes(line.data(), line.size(), idx.lines_hash);
+      } else if ((nline == 2) &&
+                 (line.compare(0, 18, "HepMC::Asciiv3-END") == 0)) {
+        // The footer, nothing after it is part of the event listing
+        if (in_header) {
+          in_header = false;
+          idx.header_end = line_offset;
+        }
+        idx.events_end = line_offset;
+        idx.lines_hash = HashBytes(line.data(), line.size(), idx.lines_hash);
+        break;
+      } else if (in_header) {
+        idx.header_hash = HashBytes(line.data(), line.size(), idx.header_hash);
+        idx.header_hash = HashBytes("\n", has_newline, idx.header_hash);
+      } else if (line.compare(0, 11, "A 0 ProcID ") == 0) {
+        idx.entries.back().ProcID =
+            int(std::strtol(line.c_str() + 11, nullptr, 10));
+      }
+    }
+
+    idx.file_size = FileSize(filename);
+    if (in_header) {
+      idx.header_end = idx.file_size;
+    }
+    if (!idx.events_end) {
+      // No footer, e.g. a file that is still being written.
+      idx.events_end = idx.file_size;
+    }
+    return idx;
+  }
+
+  void Write(std::string const &idxfile) const {
+    std::ofstream ofs(idxfile, std::ios::binary);
+    ofs.write(kMagic, sizeof(kMagic));
+    BinaryIO::WritePOD(ofs, kVersion);
+    BinaryIO::WritePOD(ofs, file_size);
+    BinaryIO::WritePOD(ofs, header_end);
+    BinaryIO::WritePOD(ofs, events_end);
+    BinaryIO::WritePOD(ofs, header_hash);
+    BinaryIO::WritePOD(ofs, lines_hash);
+    BinaryIO::WritePOD(ofs, uint64_t(entries.size()));
+    ofs.write(reinterpret_cast<char const *>(entries.data()),
+              entries.size() * sizeof(Entry));
+    if (!ofs) {
+      throw EventIndexException() << "Failed to write " << idxfile;
+    }
+  }
+
+  static EventIndex Read(std::string const &idxfile) {
+    std::ifstream ifs(idxfile, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    ifs.read(magic, sizeof(magic));
+    if (!ifs || std::memcmp(magic, kMagic, sizeof(kMagic))) {
+      throw EventIndexException() << idxfile << " is not a NuHepMC index.";
+    }
+
+    EventIndex idx;
+    uint32_t version = BinaryIO::ReadPOD<uint32_t>(ifs);
+    if (version != kVersion) {
+      throw EventIndexException() << idxfile << " has unsupported version "
+                                  << version;
+    }
+    idx.file_size = BinaryIO::ReadPOD<uint64_t>(ifs);
+    idx.header_end = BinaryIO::ReadPOD<uint64_t>(ifs);
+    idx.events_end = BinaryIO::ReadPOD<uint64_t>(ifs);
+    idx.header_hash = BinaryIO::ReadPOD<uint64_t>(ifs);
+    idx.lines_hash = BinaryIO::ReadPOD<uint64_t>(ifs);
+    idx.entries.resize(BinaryIO::ReadPOD<uint64_t>(ifs));
+    ifs.read(reinterpret_cast<char *>(idx.entries.data()),
+             idx.entries.size() * sizeof(Entry));
+    if (!ifs) {
+      throw EventIndexException() << idxfile << " is truncated.";
+    }
+    return idx;
+  }
+
+  // Checks that the index still describes filename: the size, the header, the
+  // E line at each indexed offset and the footer must all be unchanged. Only
+  // those lines are read, so the check costs one short read per event rather
+  // than a read of the whole file. An edit within the body of an event that
+  // keeps the size of the file is not found.
+  bool IsValidFor(std::string const &filename,
+                  std::string *why = nullptr) const {
+    auto Fail = [&](std::string const &reason) {
+      if (why) {
+        *why = reason;
+      }
+      return false;
+    };
+
+    if (FileSize(filename) != file_size) {
+      return Fail("file size has changed");
+    }
+
+    std::ifstream ifs(filename, std::ios::binary);
+    // E lines are short, a small buffer keeps each seek and read cheap
+    std::vector<char> iobuf(256);
+    ifs.rdbuf()->pubsetbuf(iobuf.data(), iobuf.size());
+
+    uint64_t hash = HashBytes(nullptr, 0);
+    std::vector<char> buffer(1 << 12);
+    for (uint64_t pos = 0; ifs && (pos < header_end);) {
+      size_t n = size_t(std::min<uint64_t>(buffer.size(), header_end - pos));
+      ifs.read(buffer.data(), n);
+      hash = HashBytes(buffer.data(), n, hash);
+      pos += n;
+    }
+    if (!ifs || (hash != header_hash)) {
+      return Fail("file header has changed");
+    }
+
+    hash = HashBytes(nullptr, 0);
+    std::string line;
+    auto HashLineAt = [&](uint64_t offset) {
+      ifs.seekg(offset);
+      if (std::getline(ifs, line)) {
+        hash = HashBytes(line.data(), line.size(), hash);
+      }
+      return bool(ifs);
+    };
+    for (auto const &e : entries) {
+      if (!HashLineAt(e.offset)) {
+        break;
+      }
+    }
+    if (ifs && (events_end < file_size)) {
+      HashLineAt(events_end);
+    }
+    if (!ifs || (hash != lines_hash)) {
+      return Fail("event lines have changed");
+    }
+    return true;
+  }
+
+  size_t NEvents() const { return entries.size(); }
+  Entry const &operator[](size_t i) const { return entries[i]; }
+  std::vector<Entry> const &GetEntries() const { return entries; }
+
+  // The offset of the first event, everything before it is run info.
+  uint64_t GetHeaderEnd() const { return header_end; }
+  // The offset just after the last event.
+  uint64_t GetEventsEnd() const { return events_end; }
+
+  uint64_t GetEventBegin(size_t i) const { return entries[i].offset; }
+  uint64_t GetEventEnd(size_t i) const {
+    return ((i + 1) < entries.size()) ? entries[i + 1].offset : events_end;
+  }
+
+  // Splits events [0, nevents) into at most n contiguous ranges of whole
+  // events, [first, last), with roughly equal numbers of bytes. nevents
+  // defaults to all events.
+  std::vector<std::pair<size_t, size_t>>
+  Split(size_t n, size_t nevents = std::numeric_limits<size_t>::max()) const {
+    nevents = std::min(nevents, entries.size());
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (!nevents || !n) {
+      return ranges;
+    }
+
+    uint64_t begin = entries.front().offset;
+    uint64_t nbytes = GetEventEnd(nevents - 1) - begin;
+    size_t first = 0;
+    for (size_t r = 1; (r <= n) && (first < nevents); ++r) {
+      uint64_t target = begin + (nbytes * r) / n;
+      size_t last =
+          std::lower_bound(entries.begin() + first, entries.begin() + nevents,
+                           target,
+                           [](Entry const &e, uint64_t off) {
+                             return e.offset < off;
+                           }) -
+          entries.begin();
+      if (r == n) {
+        last = nevents;
+      }
+      if (last > first) {
+        ranges.emplace_back(first, last);
+        first = last;
+      }
+    }
+    return ranges;
+  }
+
+  static uint64_t FileSize(std::string const &filename) {
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    return ifs ? uint64_t(ifs.tellg()) : 0;
+  }
+
+private:
+  static constexpr char kMagic[8] = {'N', 'u', 'H', 'e', 'p', 'I', 'd', 'x'};
+  static constexpr uint32_t kVersion = 3;
+
+  uint64_t file_size = 0;
+  uint64_t header_end = 0;
+  uint64_t events_end = 0;
+  uint64_t header_hash = 0;
+  // Of the E line of each event and of the footer line, if any
+  uint64_t lines_hash = 0;
+  std::vector<Entry> entries;
+
+};
+
+// Presents a list of byte ranges of a file, followed by a fixed trailer, as a
+// single input stream.
+class FileSegmentsStreamBuf : public std::streambuf {
+public:
+  using Segment = std::pair<uint64_t, uint64_t>; // [begin, end)
+
+  FileSegmentsStreamBuf(std::string const &filename,
+                        std::vector<Segment> segments, std::string trailer)
+      : ifs(filename, std::ios::binary), segments(std::move(segments)),
+        trailer(std::move(trailer)), buffer(1 << 16) {
+    if (!ifs) {
+      throw EventIndexException() << "Failed to open " << filename;
+    }
+  }
+
+protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+
+    while (iseg < segments.size()) {
+      auto &seg = segments[iseg];
+      if (seg.first >= seg.second) {
+        iseg++;
+        continue;
+      }
+      size_t n = size_t(std::min<uint64_t>(buffer.size(),
+                                           seg.second - seg.first));
+      ifs.clear();
+      ifs.seekg(seg.first);
+      ifs.read(buffer.data(), n);
+      n = ifs.gcount();
+      if (!n) {
+        // the file is shorter than the segment claims
+        break;
+      }
+      seg.first += n;
+      setg(buffer.data(), buffer.data(), buffer.data() + n);
+      return traits_type::to_int_type(*gptr());
+    }
+
+    if (!trailer_done) {
+      trailer_done = true;
+      std::copy(trailer.begin(), trailer.end(), buffer.begin());
+      setg(buffer.data(), buffer.data(), buffer.data() + trailer.size());
+      if (trailer.size()) {
+        return traits_type::to_int_type(*gptr());
+      }
+    }
+    return traits_type::eof();
+  }
+
+private:
+  std::ifstream ifs;
+  std::vector<Segment> segments;
+  size_t iseg = 0;
+  std::string trailer;
+  bool trailer_done = false;
+  std::vector<char> buffer;
+};
+
+// Reads events [first, last) of an indexed Asciiv3 file. The run info in the
+// file header is presented to HepMC3::ReaderAscii ahead of the first event, so
+// the reader behaves exactly as it would on a file containing only those
+// events.
+class RangeReader {
+public:
+  RangeReader(std::string const &filename, EventIndex const &index,
+              size_t first, size_t last)
+      : RangeReader(
+            filename, index.GetHeaderEnd(),
+            (first < index.NEvents()) ? index.GetEventBegin(first) : 0,
+            (first < std::min(last, index.NEvents()))
+                ? index.GetEventEnd(std::min(last, index.NEvents()) - 1)
+                : 0) {}
+
+  // Reads the whole events in the bytes [begin, end) of the file, whose
+  // header, the run info, ends at header_end.
+  RangeReader(std::string const &filename, uint64_t header_end,
+              uint64_t begin, uint64_t end)
+      : buf(filename, {{0, header_end}, {begin, end}},
+            "HepMC::Asciiv3-END_EVENT_LISTING\n\n"),
+        is(&buf), reader(std::make_unique<HepMC3::ReaderAscii>(is)) {}
+
+  HepMC3::Reader &GetReader() { return *reader; }
+
+private:
+  FileSegmentsStreamBuf buf;
+  std::istream is;
+  std::unique_ptr<HepMC3::ReaderAscii> reader;
+};
+
+} // namespace NuHepMC
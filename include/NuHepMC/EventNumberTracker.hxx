@@ -0,0 +1,292 @@
+#pragma once
+
+#include "NuHepMC/BinaryIO.hxx"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+// An exact set of event numbers for checking E.R.1 uniqueness, whose memory
+// use depends on how the numbers are distributed rather than on how many there
+// are.
+//
+// The 32 bit number space is split into blocks of 2^16 consecutive numbers and
+// each block that has been touched is stored in the most compact of three
+// forms:
+//  * a sorted array of 16 bit offsets while the block is sparse
+//    (2 bytes per number, at most 8 kB),
+//  * a 2^16 bit bitmap once it holds more than kMaxArraySize numbers (8 kB),
+//  * nothing at all once every number in the block has been seen.
+// A file numbered 1..N therefore costs a few tens of bytes per 65536 events
+// plus a single partially-filled bitmap, while sparse numbering degrades to
+// 2 bytes per event rather than the ~40 of a std::set<int>.
+//
+// Not thread-safe, but trackers filled independently, e.g. one per shard or
+// per thread, can be combined with Merge.
+class EventNumberTracker {
+public:
+  static constexpr uint32_t kBlockSize = 1 << 16;
+  static constexpr uint32_t kMaxArraySize = 4096;
+
+  EventNumberTracker() = default;
+  EventNumberTracker(EventNumberTracker const &other)
+      : blocks(other.blocks), nentries(other.nentries) {}
+  EventNumberTracker(EventNumberTracker &&other)
+      : blocks(std::move(other.blocks)), nentries(other.nentries) {
+    other.Clear();
+  }
+  EventNumberTracker &operator=(EventNumberTracker const &other) {
+    blocks = other.blocks;
+    nentries = other.nentries;
+    last = nullptr;
+    return *this;
+  }
+  EventNumberTracker &operator=(EventNumberTracker &&other) {
+    blocks = std::move(other.blocks);
+    nentries = other.nentries;
+    last = nullptr;
+    other.Clear();
+    return *this;
+  }
+
+  void Clear() {
+    blocks.clear();
+    nentries = 0;
+    last = nullptr;
+  }
+
+  // Returns false if evnum had already been inserted.
+  bool Insert(int evnum) {
+    uint32_t key = ToKey(evnum);
+    bool inserted = GetBlock(key >> 16).Insert(key & 0xFFFF);
+    nentries += inserted;
+    return inserted;
+  }
+
+  bool Contains(int evnum) const {
+    uint32_t key = ToKey(evnum);
+    auto it = blocks.find(key >> 16);
+    return (it != blocks.end()) && it->second.Contains(key & 0xFFFF);
+  }
+
+  size_t Size() const { return nentries; }
+
+  // Adds every event number in other, returns the number of them that were
+  // already present, i.e. the number of duplicates between the two sets.
+  size_t Merge(EventNumberTracker const &other) {
+    size_t nduplicates = 0;
+    for (auto const &ob : other.blocks) {
+      auto it = blocks.find(ob.first);
+      if (it == blocks.end()) {
+        blocks.emplace(ob.first, ob.second);
+        nentries += ob.second.count;
+        continue;
+      }
+      ob.second.ForEach([&](uint16_t low) {
+        if (it->second.Insert(low)) {
+          nentries++;
+        } else {
+          nduplicates++;
+        }
+      });
+    }
+    last = nullptr;
+    return nduplicates;
+  }
+
+  // An estimate of the heap memory used, in bytes.
+  size_t MemoryUsage() const {
+    size_t bytes = 0;
+    for (auto const &b : blocks) {
+      // approximate size of a std::map node
+      bytes += sizeof(b) + 4 * sizeof(void *);
+      bytes += b.second.array.capacity() * sizeof(uint16_t);
+      bytes += b.second.bitmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+  }
+
+  // Writes the set in a compact binary form, each block is stored in its
+  // in-memory form, so that checking can be resumed by a later process.
+  void Write(std::ostream &os) const {
+    BinaryIO::WritePOD(os, uint64_t(blocks.size()));
+    for (auto const &b : blocks) {
+      BinaryIO::WritePOD(os, b.first);
+      BinaryIO::WritePOD(os, b.second.count);
+      if (b.second.IsFull()) {
+        continue;
+      }
+      if (b.second.bitmap.size()) {
+        os.write(reinterpret_cast<char const *>(b.second.bitmap.data()),
+                 b.second.bitmap.size() * sizeof(uint64_t));
+      } else {
+        os.write(reinterpret_cast<char const *>(b.second.array.data()),
+                 b.second.array.size() * sizeof(uint16_t));
+      }
+    }
+  }
+
+  // Replaces the contents with a set written by Write. Returns false, leaving
+  // the tracker empty, if the stream is truncated or malformed.
+  bool Read(std::istream &is) {
+    Clear();
+    uint64_t nblocks = BinaryIO::ReadPOD<uint64_t>(is);
+    for (uint64_t i = 0; is && (i < nblocks); ++i) {
+      uint32_t high = BinaryIO::ReadPOD<uint32_t>(is);
+      Block b;
+      b.count = BinaryIO::ReadPOD<uint32_t>(is);
+      if (!is || !b.count || (b.count > kBlockSize) || (high >= kBlockSize) ||
+          blocks.count(high)) {
+        Clear();
+        return false;
+      }
+      if (b.count > kMaxArraySize) {
+        if (!b.IsFull()) {
+          b.bitmap.resize(kBlockSize / 64);
+          is.read(reinterpret_cast<char *>(b.bitmap.data()),
+                  b.bitmap.size() * sizeof(uint64_t));
+          uint32_t nset = 0;
+          for (uint64_t word : b.bitmap) {
+            nset += uint32_t(__builtin_popcountll(word));
+          }
+          if (nset != b.count) {
+            Clear();
+            return false;
+          }
+        }
+      } else {
+        b.array.resize(b.count);
+        is.read(reinterpret_cast<char *>(b.array.data()),
+                b.array.size() * sizeof(uint16_t));
+        // strictly ascending
+        if (std::adjacent_find(b.array.begin(), b.array.end(),
+                               std::greater_equal<uint16_t>()) !=
+            b.array.end()) {
+          Clear();
+          return false;
+        }
+      }
+      nentries += b.count;
+      blocks.emplace(high, std::move(b));
+    }
+    if (!is) {
+      Clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Calls f(evnum) for each event number in ascending order.
+  template <typename F> void ForEach(F const &f) const {
+    for (auto const &b : blocks) {
+      b.second.ForEach([&](uint16_t low) {
+        f(FromKey((b.first << 16) | low));
+      });
+    }
+  }
+
+private:
+  struct Block {
+    uint32_t count = 0;
+    std::vector<uint16_t> array;
+    std::vector<uint64_t> bitmap;
+
+    bool IsFull() const { return count == kBlockSize; }
+
+    bool Contains(uint16_t low) const {
+      if (IsFull()) {
+        return true;
+      }
+      if (bitmap.size()) {
+        return (bitmap[low >> 6] >> (low & 63)) & 1;
+      }
+      return std::binary_search(array.begin(), array.end(), low);
+    }
+
+    bool Insert(uint16_t low) {
+      if (IsFull()) {
+        return false;
+      }
+
+      if (bitmap.size()) {
+        uint64_t &word = bitmap[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (word & bit) {
+          return false;
+        }
+        word |= bit;
+        if (++count == kBlockSize) {
+          std::vector<uint64_t>().swap(bitmap);
+        }
+        return true;
+      }
+
+      auto it = std::lower_bound(array.begin(), array.end(), low);
+      if ((it != array.end()) && (*it == low)) {
+        return false;
+      }
+      array.insert(it, low);
+      if (++count > kMaxArraySize) {
+        bitmap.assign(kBlockSize / 64, 0);
+        for (uint16_t l : array) {
+          bitmap[l >> 6] |= uint64_t(1) << (l & 63);
+        }
+        std::vector<uint16_t>().swap(array);
+      }
+      return true;
+    }
+
+    template <typename F> void ForEach(F const &f) const {
+      if (IsFull()) {
+        for (uint32_t l = 0; l < kBlockSize; ++l) {
+          f(uint16_t(l));
+        }
+      } else if (bitmap.size()) {
+        for (uint32_t w = 0; w < bitmap.size(); ++w) {
+          for (uint64_t word = bitmap[w]; word; word &= (word - 1)) {
+            f(uint16_t((w << 6) | __builtin_ctzll(word)));
+          }
+        }
+      } else {
+        for (uint16_t l : array) {
+          f(l);
+        }
+      }
+    }
+  };
+
+  // Flip the sign bit so that the unsigned keys sort in the same order as the
+  // signed event numbers.
+  static uint32_t ToKey(int evnum) {
+    return uint32_t(evnum) ^ 0x80000000u;
+  }
+  static int FromKey(uint32_t key) { return int(key ^ 0x80000000u); }
+
+  // Event numbers are usually written in ascending order, so consecutive
+  // inserts almost always land in the same block.
+  Block &GetBlock(uint32_t high) {
+    if (last && (last_high == high)) {
+      return *last;
+    }
+    last = &blocks[high];
+    last_high = high;
+    return *last;
+  }
+
+
+  std::map<uint32_t, Block> blocks;
+  size_t nentries = 0;
+
+  Block *last = nullptr;
+  uint32_t last_high = 0;
+};
+
+} // namespace NuHepMC
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/Reader.h"
+
+#include "NuHepMC/Profiling.hxx"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NuHepMC {
+
+// A fixed-capacity multi-producer/multi-consumer queue. Push blocks while the
+// queue is full, which provides the backpressure that keeps a fast producer
+// from buffering an unbounded number of objects.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+  // Returns false if the queue was closed before obj could be enqueued.
+  bool Push(T &&obj) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this] { return closed || queue.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    queue.push_back(std::move(obj));
+    not_empty.notify_one();
+    return true;
+  }
+
+  // Returns false once the queue has been closed and fully drained.
+  bool Pop(T &obj) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this] { return closed || !queue.empty(); });
+    if (queue.empty()) {
+      return false;
+    }
+    obj = std::move(queue.front());
+    queue.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+private:
+  size_t capacity;
+  bool closed = false;
+  std::deque<T> queue;
+  std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+};
+
+// Drives a reader through two processing stages:
+//  * the serial stage runs on the reading thread, once per event, in file
+//    order. It is the place for checks that carry state between events.
+//  * the parallel stage runs on a pool of worker threads and must only touch
+//    the event that it is passed and read-only shared state.
+//
+// Each event is tagged with its 0-based position in the file. The parallel
+// stage is also passed the index, in [0, GetNSlots()), of the worker that it
+// is running on, which can be used to address per-worker state. The serial
+// stage is always passed slot 0, but may run concurrently with worker 0.
+//
+// An exception thrown from either stage stops the reader; once all in-flight
+// events have been processed, the exception belonging to the earliest event in the
+// file is rethrown. The reported failure is therefore identical to the one a
+// single-threaded loop running both stages back to back would report,
+// independent of the number of workers.
+class EventPipeline {
+public:
+  using Stage =
+      std::function<void(HepMC3::GenEvent const &, size_t seq, size_t slot)>;
+
+  // With nworkers == 0 both stages are run inline on the calling thread.
+  explicit EventPipeline(size_t nworkers, size_t queue_depth = 0)
+      : nworkers(nworkers),
+        queue_depth(queue_depth ? queue_depth : 4 * nworkers) {}
+
+  // The number of distinct slot indices that stages may be called with.
+  size_t GetNSlots() const { return nworkers ? nworkers : 1; }
+
+  // first must be the event most recently read from reader, the loop runs
+  // until the reader reports failure, which is how HepMC3 readers signal the
+  // end of the file. Returns the number of events processed.
+  size_t Run(HepMC3::Reader &reader, HepMC3::GenEvent &first,
+             Stage const &serial, Stage const &parallel) {
+    first_failure = std::numeric_limits<size_t>::max();
+    failure = nullptr;
+
+    return nworkers ? RunThreaded(reader, first, serial, parallel)
+                    : RunInline(reader, first, serial, parallel);
+  }
+
+  // As Run, but for lightweight events of type Event that are produced on
+  // the calling thread by next(Event &), which returns false at the end of the
+  // input. Events are copied to the workers in batches, so Event should be
+  // cheap to copy, e.g. a view of a memory-mapped file.
+  template <typename Event, typename Next, typename SerialStage,
+            typename ParallelStage>
+  size_t RunSource(Next const &next, SerialStage const &serial,
+                   ParallelStage const &parallel) {
+    first_failure = std::numeric_limits<size_t>::max();
+    failure = nullptr;
+
+    size_t seq = 0;
+    Event evt;
+    // Times next, which includes the time to produce the event.
+    auto TimedNext = [&](Event &evt) {
+      NuHepMC_PROFILE_SCOPE("Pipeline.Next");
+      return next(evt);
+    };
+
+    if (!nworkers) {
+      while (TimedNext(evt)) {
+        serial(evt, seq, size_t(0));
+        parallel(evt, seq, size_t(0));
+        seq++;
+      }
+      return seq;
+    }
+
+    struct Batch {
+      size_t first_seq;
+      std::vector<Event> events;
+    };
+    size_t const batch_size = 64;
+    BoundedQueue<Batch> work(queue_depth);
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < nworkers; ++i) {
+      workers.emplace_back([&, i, this]() {
+        Batch batch;
+        while (work.Pop(batch)) {
+          for (size_t j = 0; j < batch.events.size(); ++j) {
+            size_t evseq = batch.first_seq + j;
+            if (Failed(evseq)) {
+              break;
+            }
+            try {
+              parallel(batch.events[j], evseq, i);
+            } catch (...) {
+              RecordFailure(evseq, std::current_exception());
+              break;
+            }
+          }
+        }
+      });
+    }
+
+    Batch batch{0, {}};
+    try {
+      while (!Failed(seq) && TimedNext(evt)) {
+        try {
+          serial(evt, seq, size_t(0));
+        } catch (...) {
+          RecordFailure(seq, std::current_exception());
+          break;
+        }
+        batch.events.push_back(evt);
+        seq++;
+        if (batch.events.size() == batch_size) {
+          NuHepMC_PROFILE_SCOPE("Pipeline.WaitForWorkers");
+          work.Push(std::move(batch));
+          batch = Batch{seq, {}};
+          batch.events.reserve(batch_size);
+        }
+      }
+    } catch (...) {
+      RecordFailure(seq, std::current_exception());
+    }
+    if (batch.events.size()) {
+      work.Push(std::move(batch));
+    }
+
+    work.Close();
+    for (auto &w : workers) {
+      w.join();
+    }
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    return seq;
+  }
+
+  // Processes contiguous sections of a file, each through its own reader on
+  // its own thread, e.g. RangeReaders over an EventIndex. first_seq[i] is the
+  // position in the file of the first event read by readers[i], and stage is
+  // passed i as the slot. There is no serial stage, state that must be
+  // carried between events has to be handled separately. Failures are
+  // resolved as for Run. Returns the number of events processed.
+  size_t RunShards(std::vector<HepMC3::Reader *> const &readers,
+                   std::vector<size_t> const &first_seq, Stage const &stage) {
+    first_failure = std::numeric_limits<size_t>::max();
+    failure = nullptr;
+
+    std::atomic<size_t> nprocessed{0};
+    std::vector<std::thread> shards;
+    for (size_t i = 0; i < readers.size(); ++i) {
+      shards.emplace_back([&, i, this]() {
+        HepMC3::GenEvent evt;
+        size_t seq = first_seq[i];
+        try {
+          readers[i]->read_event(evt);
+          while (!readers[i]->failed() && !Failed(seq)) {
+            stage(evt, seq, i);
+            seq++;
+            NuHepMC_PROFILE_SCOPE("Pipeline.Read");
+            readers[i]->read_event(evt);
+          }
+        } catch (...) {
+          RecordFailure(seq, std::current_exception());
+        }
+        nprocessed += (seq - first_seq[i]);
+      });
+    }
+    for (auto &s : shards) {
+      s.join();
+    }
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    return nprocessed;
+  }
+
+private:
+  struct Item {
+    size_t seq;
+    std::unique_ptr<HepMC3::GenEvent> evt;
+  };
+
+  size_t nworkers;
+  size_t queue_depth;
+
+  std::atomic<size_t> first_failure;
+  std::exception_ptr failure;
+  std::mutex failure_mutex;
+
+  std::vector<std::unique_ptr<HepMC3::GenEvent>> spent;
+  std::mutex spent_mutex;
+
+  void RecordFailure(size_t seq, std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(failure_mutex);
+    if (seq < first_failure) {
+      first_failure = seq;
+      failure = e;
+    }
+  }
+
+  bool Failed(size_t seq) const { return first_failure <= seq; }
+
+  // Events are recycled between the workers and the reader so that
+  // the containers of each GenEvent are reused rather than reallocated.
+  std::unique_ptr<HepMC3::GenEvent> GetEvent() {
+    std::lock_guard<std::mutex> lock(spent_mutex);
+    if (spent.empty()) {
+      return std::make_unique<HepMC3::GenEvent>();
+    }
+    auto evt = std::move(spent.back());
+    spent.pop_back();
+    return evt;
+  }
+
+  void ReturnEvent(std::unique_ptr<HepMC3::GenEvent> evt) {
+    std::lock_guard<std::mutex> lock(spent_mutex);
+    spent.push_back(std::move(evt));
+  }
+
+  size_t RunInline(HepMC3::Reader &reader, HepMC3::GenEvent &evt,
+                   Stage const &serial, Stage const &parallel) {
+    size_t seq = 0;
+    while (!reader.failed()) {
+      serial(evt, seq, 0);
+      parallel(evt, seq, 0);
+      seq++;
+      NuHepMC_PROFILE_SCOPE("Pipeline.Read");
+      reader.read_event(evt);
+    }
+    return seq;
+  }
+
+  size_t RunThreaded(HepMC3::Reader &reader, HepMC3::GenEvent &first,
+                     Stage const &serial, Stage const &parallel) {
+    BoundedQueue<Item> work(queue_depth);
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < nworkers; ++i) {
+      workers.emplace_back([&, i, this]() {
+        Item item;
+        while (work.Pop(item)) {
+          if (!Failed(item.seq)) {
+            try {
+              parallel(*item.evt, item.seq, i);
+            } catch (...) {
+              RecordFailure(item.seq, std::current_exception());
+            }
+          }
+          ReturnEvent(std::move(item.evt));
+        }
+      });
+    }
+
+    size_t seq = 0;
+    if (!reader.failed()) {
+      auto evt = std::make_unique<HepMC3::GenEvent>(first);
+      while (!Failed(seq)) {
+        try {
+          serial(*evt, seq, 0);
+        } catch (...) {
+          RecordFailure(seq, std::current_exception());
+          break;
+        }
+
+        {
+          NuHepMC_PROFILE_SCOPE("Pipeline.WaitForWorkers");
+          work.Push(Item{seq, std::move(evt)});
+        }
+        seq++;
+
+        evt = GetEvent();
+        try {
+          NuHepMC_PROFILE_SCOPE("Pipeline.Read");
+          reader.read_event(*evt);
+        } catch (...) {
+          RecordFailure(seq, std::current_exception());
+          break;
+        }
+        if (reader.failed()) {
+          break;
+        }
+      }
+    }
+
+    work.Close();
+    for (auto &w : workers) {
+      w.join();
+    }
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    return seq;
+  }
+};
+
+} // namespace NuHepMC
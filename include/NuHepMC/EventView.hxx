@@ -0,0 +1,190 @@
+#pragma once
+
+#include "HepMC3/FourVector.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenVertex.h"
+
+#include "NuHepMC/Constants.hxx"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace NuHepMC {
+
+// A flattened, read-only copy of the parts of a HepMC3::GenEvent that
+// selection loops look at, built once per event. Particle and vertex
+// properties are stored as parallel arrays, indexed by position in
+// evt.particles() and evt.vertices() respectively, so that loops over them
+// read contiguous memory instead of chasing a shared_ptr per particle.
+//
+// A view is intended to be reused from event to event, Fill keeps the
+// capacity of every array so that steady-state filling does not allocate.
+//
+//   NuHepMC::EventView view;
+//   while (reader.read_event(evt), !reader.failed()) {
+//     view.Fill(evt);
+//     for (int i : view.final_state) {
+//       if (view.pid[i] == 13) {
+//         muon_e += view.e[i];
+//       }
+//     }
+//   }
+struct EventView {
+  // Per-particle arrays, the i-th entry describes evt.particles()[i].
+  std::vector<int> pid;
+  std::vector<int> status;
+  std::vector<double> px;
+  std::vector<double> py;
+  std::vector<double> pz;
+  std::vector<double> e;
+  // The mass stored with the particle, see Mass(i) for the mass computed
+  // from the four-momentum.
+  std::vector<double> generated_mass;
+  // Index of the production and end vertex in the per-vertex arrays, -1 for
+  // none. Particles attached to the event's root vertex have no production
+  // vertex.
+  std::vector<int> production_vertex;
+  std::vector<int> end_vertex;
+
+  // Per-vertex arrays, the i-th entry describes evt.vertices()[i].
+  std::vector<int> vertex_status;
+
+  // Index of the first vertex with VertexStatus::kPrimaryVertex, -1 if the
+  // event has none, and the indices of its incoming and outgoing particles.
+  // HepMC3 numbers particles from 1 in the order of evt.particles(), so the
+  // index of a particle is its id() - 1.
+  int primary_vertex = -1;
+  std::vector<int> primary_in;
+  std::vector<int> primary_out;
+
+  // Indices of the particles with ParticleStatus::kIncomingBeamParticle,
+  // ParticleStatus::kTargetParticle and
+  // ParticleStatus::kUndecayedPhysicalParticle, in event order.
+  std::vector<int> beams;
+  std::vector<int> targets;
+  std::vector<int> final_state;
+
+  EventView() = default;
+  explicit EventView(HepMC3::GenEvent const &evt) { Fill(evt); }
+
+  void Fill(HepMC3::GenEvent const &evt) {
+    Clear();
+
+    auto const &particles = evt.particles();
+    size_t nparts = particles.size();
+    pid.reserve(nparts);
+    status.reserve(nparts);
+    px.reserve(nparts);
+    py.reserve(nparts);
+    pz.reserve(nparts);
+    e.reserve(nparts);
+    generated_mass.reserve(nparts);
+    production_vertex.reserve(nparts);
+    end_vertex.reserve(nparts);
+
+    for (auto const &part : particles) {
+      int i = int(pid.size());
+      pid.push_back(part->pid());
+      status.push_back(part->status());
+      auto const &mom = part->momentum();
+      px.push_back(mom.px());
+      py.push_back(mom.py());
+      pz.push_back(mom.pz());
+      e.push_back(mom.e());
+      generated_mass.push_back(part->generated_mass());
+      production_vertex.push_back(VertexIndex(part->production_vertex()));
+      end_vertex.push_back(VertexIndex(part->end_vertex()));
+
+      switch (status.back()) {
+      case ParticleStatus::kIncomingBeamParticle: {
+        beams.push_back(i);
+        break;
+      }
+      case ParticleStatus::kTargetParticle: {
+        targets.push_back(i);
+        break;
+      }
+      case ParticleStatus::kUndecayedPhysicalParticle: {
+        final_state.push_back(i);
+        break;
+      }
+      default: {
+      }
+      }
+    }
+
+    auto const &vertices = evt.vertices();
+    vertex_status.reserve(vertices.size());
+    for (auto const &vtx : vertices) {
+      vertex_status.push_back(vtx->status());
+      if ((primary_vertex < 0) &&
+          (vertex_status.back() == VertexStatus::kPrimaryVertex)) {
+        primary_vertex = int(vertex_status.size()) - 1;
+        for (auto const &part : vtx->particles_in()) {
+          primary_in.push_back(part->id() - 1);
+        }
+        for (auto const &part : vtx->particles_out()) {
+          primary_out.push_back(part->id() - 1);
+        }
+      }
+    }
+  }
+
+  void Clear() {
+    pid.clear();
+    status.clear();
+    px.clear();
+    py.clear();
+    pz.clear();
+    e.clear();
+    generated_mass.clear();
+    production_vertex.clear();
+    end_vertex.clear();
+    vertex_status.clear();
+    primary_vertex = -1;
+    primary_in.clear();
+    primary_out.clear();
+    beams.clear();
+    targets.clear();
+    final_state.clear();
+  }
+
+  size_t NParticles() const { return pid.size(); }
+  size_t NVertices() const { return vertex_status.size(); }
+
+  HepMC3::FourVector Momentum(int i) const {
+    return HepMC3::FourVector(px[i], py[i], pz[i], e[i]);
+  }
+
+  // The invariant mass of particle i, computed from its four-momentum
+  double Mass(int i) const {
+    double m2 = (e[i] * e[i]) - (px[i] * px[i]) - (py[i] * py[i]) -
+                (pz[i] * pz[i]);
+    return (m2 > 0) ? std::sqrt(m2) : -std::sqrt(-m2);
+  }
+
+  // Returns the index of the first particle in the list with the given PDG
+  // code, or -1, e.g. view.FindFirst(view.final_state, 13)
+  int FindFirst(std::vector<int> const &indices, int code) const {
+    for (int i : indices) {
+      if (pid[i] == code) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+private:
+  // Vertex ids count down from -1 in evt.vertices() order, the root vertex
+  // has id 0 and is not in evt.vertices().
+  static int VertexIndex(HepMC3::ConstGenVertexPtr const &vtx) {
+    if (!vtx || (vtx->id() >= 0)) {
+      return -1;
+    }
+    return -vtx->id() - 1;
+  }
+};
+
+} // namespace NuHepMC
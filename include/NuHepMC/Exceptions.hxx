@@ -1,6 +1,8 @@
 #pragma once
 
+#include <sstream>
 #include <stdexcept>
+#include <string>
 
 namespace NuHepMC {
 struct except : public std::exception {
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace NuHepMC {
+
+// Returns str as a quoted JSON string literal.
+inline std::string JSONQuote(std::string const &str) {
+  std::string out = "\"";
+  for (char c : str) {
+    switch (c) {
+    case '"': {
+      out += "\\\"";
+      break;
+    }
+    case '\\': {
+      out += "\\\\";
+      break;
+    }
+    case '\n': {
+      out += "\\n";
+      break;
+    }
+    case '\t': {
+      out += "\\t";
+      break;
+    }
+    case '\r': {
+      out += "\\r";
+      break;
+    }
+    default: {
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+    }
+  }
+  return out + "\"";
+}
+
+} // namespace NuHepMC
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/Reader.h"
+#include "HepMC3/ReaderFactory.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(MergeException);
+
+namespace Merge {
+
+// Reads only as far as the first event of filename, which is enough for
+// HepMC3 to have parsed the run info.
+inline std::shared_ptr<HepMC3::GenRunInfo>
+ReadRunInfo(std::string const &filename) {
+  auto reader = HepMC3::deduce_reader(filename);
+  if (!reader) {
+    throw MergeException() << "Failed to open " << filename;
+  }
+  HepMC3::GenEvent evt;
+  reader->read_event(evt);
+  auto run_info = reader->run_info();
+  reader->close();
+  if (!run_info) {
+    throw MergeException() << filename << " has no GenRunInfo.";
+  }
+  return run_info;
+}
+
+// Counts the events in filename, from the event lines alone for Asciiv3.
+inline size_t CountEvents(std::string const &filename) {
+  try {
+    MappedFile mapped(filename);
+    AsciiEventScanner scanner(mapped.begin(), mapped.end());
+    RawEvent raw;
+    size_t nevents = 0;
+    while (scanner.Next(raw)) {
+      nevents++;
+    }
+    return nevents;
+  } catch (AsciiScannerException &) {
+  }
+
+  auto reader = HepMC3::deduce_reader(filename);
+  if (!reader) {
+    throw MergeException() << "Failed to open " << filename;
+  }
+  HepMC3::GenEvent evt;
+  size_t nevents = 0;
+  reader->read_event(evt);
+  while (!reader->failed()) {
+    nevents++;
+    reader->read_event(evt);
+  }
+  return nevents;
+}
+
+// Events from the shards can only be combined if they mean the same thing
+// in each: the process, vertex status and particle status definitions
+// (G.R.4-6) and the weight names (G.R.7), which events only refer to by
+// position, must all match. Throws MergeException naming the first mismatch.
+inline void
+CheckCompatible(std::vector<std::string> const &filenames,
+                std::vector<std::shared_ptr<HepMC3::GenRunInfo>> &run_infos) {
+  auto &ref = run_infos.front();
+  auto ref_procs = GenRunInfo::ReadProcessIDDefinitions(ref);
+  auto ref_vtx = GenRunInfo::ReadVertexStatusIDDefinitions(ref);
+  auto ref_part = GenRunInfo::ReadParticleStatusIDDefinitions(ref);
+
+  for (size_t i = 1; i < run_infos.size(); ++i) {
+    auto &ri = run_infos[i];
+    auto Fail = [&](std::string const &what) {
+      throw MergeException()
+          << filenames[i] << " has different " << what << " to "
+          << filenames.front() << ", the files cannot be merged.";
+    };
+
+    if (GenRunInfo::ReadProcessIDDefinitions(ri) != ref_procs) {
+      Fail("process definitions (G.R.4)");
+    }
+    if (GenRunInfo::ReadVertexStatusIDDefinitions(ri) != ref_vtx) {
+      Fail("vertex status definitions (G.R.5)");
+    }
+    if (GenRunInfo::ReadParticleStatusIDDefinitions(ri) != ref_part) {
+      Fail("particle status definitions (G.R.6)");
+    }
+    if (ri->weight_names() != ref->weight_names()) {
+      Fail("weight names (G.R.7)");
+    }
+  }
+}
+
+// Returns the value of the attribute name from each shard, or an empty vector
+// if no shard has it. Throws MergeException if only some shards have it.
+template <typename AT>
+auto CollectAttribute(
+    std::vector<std::string> const &filenames,
+    std::vector<std::shared_ptr<HepMC3::GenRunInfo>> const &run_infos,
+    std::string const &name) {
+  using value_type = decltype(std::declval<AT>().value());
+  std::vector<value_type> values;
+  bool first_present = false;
+  for (size_t i = 0; i < run_infos.size(); ++i) {
+    bool present = HasAttribute(run_infos[i], name);
+    if (!i) {
+      first_present = present;
+    } else if (present != first_present) {
+      throw MergeException()
+          << name << " is present in "
+          << (present ? filenames[i] : filenames.front()) << " but not "
+          << (present ? filenames.front() : filenames[i])
+          << ", it must be present in every shard or in none.";
+    }
+    if (present) {
+      values.push_back(CheckedAttributeValue<AT>(run_infos[i], name));
+    }
+  }
+  return values;
+}
+
+// The run info of the merged file: that of the first shard, with the exposure
+// (G.C.2, G.C.3) summed over the shards and the flux-averaged total cross
+// section (G.C.4) replaced by the mean of the shard values, weighted by the
+// number of events in each. Exposure and cross section attributes must be
+// present in every shard or in none.
+//
+// nevents[i] is the number of events in shard i, which is read from
+// NuHepMC.Exposure.NEvents. If no shard has NuHepMC.Exposure.NEvents, each
+// shard is read an extra time to count its events, as they are needed before
+// the merged run info can be written.
+inline std::shared_ptr<HepMC3::GenRunInfo>
+MergeRunInfo(std::vector<std::string> const &filenames,
+             std::vector<std::shared_ptr<HepMC3::GenRunInfo>> &run_infos,
+             std::vector<size_t> &nevents) {
+  CheckCompatible(filenames, run_infos);
+
+  auto counts = CollectAttribute<HepMC3::LongAttribute>(
+      filenames, run_infos, "NuHepMC.Exposure.NEvents");
+  bool has_nevents = counts.size();
+
+  nevents.clear();
+  long total = 0;
+  for (size_t i = 0; i < run_infos.size(); ++i) {
+    long n = has_nevents ? counts[i] : long(CountEvents(filenames[i]));
+    nevents.push_back(size_t(n));
+    total += n;
+  }
+
+  auto merged = run_infos.front();
+
+  if (has_nevents) {
+    merged->add_attribute("NuHepMC.Exposure.NEvents",
+                          std::make_shared<HepMC3::LongAttribute>(total));
+  }
+
+  for (std::string name :
+       {"NuHepMC.Exposure.POT", "NuHepMC.Exposure.Livetime"}) {
+    auto values =
+        CollectAttribute<HepMC3::DoubleAttribute>(filenames, run_infos, name);
+    if (values.empty()) {
+      continue;
+    }
+    double sum = 0;
+    for (double v : values) {
+      sum += v;
+    }
+    merged->add_attribute(name, std::make_shared<HepMC3::DoubleAttribute>(sum));
+  }
+
+  auto fatx = CollectAttribute<HepMC3::DoubleAttribute>(
+      filenames, run_infos, "NuHepMC.FluxAveragedTotalCrossSection");
+  if (fatx.size() && total) {
+    double weighted = 0;
+    for (size_t i = 0; i < fatx.size(); ++i) {
+      weighted += fatx[i] * nevents[i];
+    }
+    merged->add_attribute("NuHepMC.FluxAveragedTotalCrossSection",
+                          std::make_shared<HepMC3::DoubleAttribute>(
+                              weighted / double(total)));
+  }
+
+  return merged;
+}
+
+} // namespace Merge
+
+// Reads a list of compatible files as if they were a single merged file: the
+// run info is the merged run info and events are renumbered consecutively
+// from first_evnum in the order that they are read. Works with any format
+// that HepMC3::deduce_reader can open.
+class ConcatenatedReader : public HepMC3::Reader {
+public:
+  explicit ConcatenatedReader(std::vector<std::string> filenames,
+                              int first_evnum = 1)
+      : filenames(std::move(filenames)), next_evnum(first_evnum) {
+    if (this->filenames.empty()) {
+      throw MergeException() << "No files to read.";
+    }
+    std::vector<std::shared_ptr<HepMC3::GenRunInfo>> run_infos;
+    for (auto const &f : this->filenames) {
+      run_infos.push_back(Merge::ReadRunInfo(f));
+    }
+    set_run_info(Merge::MergeRunInfo(this->filenames, run_infos, nevents));
+  }
+
+  bool read_event(HepMC3::GenEvent &evt) override {
+    while (ifile < filenames.size()) {
+      if (!reader) {
+        reader = HepMC3::deduce_reader(filenames[ifile]);
+        if (!reader) {
+          throw MergeException() << "Failed to open " << filenames[ifile];
+        }
+      }
+      reader->read_event(evt);
+      if (!reader->failed()) {
+        evt.set_run_info(run_info());
+        evt.set_event_number(next_evnum++);
+        return true;
+      }
+      reader->close();
+      reader = nullptr;
+      ifile++;
+    }
+    done = true;
+    return false;
+  }
+
+  bool skip(const int n) override {
+    HepMC3::GenEvent evt;
+    for (int i = 0; i < n; ++i) {
+      if (!read_event(evt)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool failed() override { return done; }
+
+  void close() override {
+    if (reader) {
+      reader->close();
+      reader = nullptr;
+    }
+    ifile = filenames.size();
+  }
+
+  // The number of events in each file.
+  std::vector<size_t> const &GetNEvents() const { return nevents; }
+
+private:
+  std::vector<std::string> filenames;
+  std::vector<size_t> nevents;
+  size_t ifile = 0;
+  std::shared_ptr<HepMC3::Reader> reader;
+  int next_evnum;
+  bool done = false;
+};
+
+} // namespace NuHepMC
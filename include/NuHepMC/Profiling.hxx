@@ -0,0 +1,512 @@
+#pragma once
+
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/JSONUtils.hxx"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Instrumentation for finding where the time of a run goes without an
+// external profiler. It is compiled in by defining NuHepMC_ENABLE_PROFILING,
+// e.g. with the CMake option of the same name, otherwise the macros expand to
+// nothing.
+//
+//   NuHepMC_PROFILE_SCOPE("Validation.FillEventFields"); // times the scope
+//   NuHepMC_PROFILE_COUNT("Input.DecompressedBytes", n); // adds n
+//   NuHepMC_PROFILE_EVENTS(1, nbytes); // the events and bytes processed
+//
+// and NuHepMC_PROFILE_ALLOCATIONS(), placed once at global scope in an
+// executable, counts calls to operator new. NuHepMC_COUNT_ALLOCATIONS() does
+// the same whether or not profiling is enabled, for programs such as the
+// benchmarks that read the count with GetNAllocations but should not pay for
+// the other probes.
+//
+// Each probe is registered by name once, on first use. Every thread
+// accumulates into its own copy of the probes, which are only summed when a
+// Snapshot is taken, so a timed scope costs two clock reads and a counter an
+// uncontended store.
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(ProfilingException);
+
+namespace Profiling {
+
+#ifdef NuHepMC_ENABLE_PROFILING
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+enum class Kind { kTimer, kCounter };
+
+using ProbeId = size_t;
+
+// Registered first, in this order, by every Profiler.
+const ProbeId kEvents = 0;
+const ProbeId kBytes = 1;
+const ProbeId kAllocations = 2;
+
+const size_t kMaxProbes = 256;
+
+struct ProbeStats {
+  uint64_t calls = 0;
+  // Nanoseconds for a timer, the sum of the amounts for a counter
+  uint64_t total = 0;
+};
+
+// The probes of one thread. Only the owning thread writes them, but they may
+// be read by a Snapshot on another thread at any time.
+class ThreadProbes {
+public:
+  ThreadProbes();
+  ~ThreadProbes();
+
+  ThreadProbes(ThreadProbes const &) = delete;
+  ThreadProbes &operator=(ThreadProbes const &) = delete;
+
+  void Add(ProbeId id, uint64_t amount) {
+    auto &p = probes[id];
+    p.calls.store(p.calls.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    p.total.store(p.total.load(std::memory_order_relaxed) + amount,
+                  std::memory_order_relaxed);
+  }
+
+  ProbeStats Get(ProbeId id) const {
+    ProbeStats s;
+    s.calls = probes[id].calls.load(std::memory_order_relaxed);
+    s.total = probes[id].total.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  struct Probe {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total{0};
+  };
+  std::array<Probe, kMaxProbes> probes;
+};
+
+// The probes of the thread, once created, and whether they are being created
+// or have been destroyed.
+inline thread_local ThreadProbes *tls_probes = nullptr;
+inline thread_local bool tls_probes_busy = false;
+
+// The probes of the calling thread. With create == false, returns nullptr
+// rather than creating them, which is what an allocation hook must do, as
+// creating them allocates.
+inline ThreadProbes *CurrentThreadProbes(bool create = true) {
+  if (!tls_probes && create && !tls_probes_busy) {
+    tls_probes_busy = true;
+    thread_local ThreadProbes probes;
+    tls_probes = &probes;
+    tls_probes_busy = false;
+  }
+  return tls_probes;
+}
+
+class Profiler {
+public:
+  struct Probe {
+    std::string name;
+    Kind kind;
+    ProbeStats stats;
+  };
+
+  static Profiler &Get() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  // Returns the id of the probe called name, registering it if it is new.
+  ProbeId Register(std::string const &name, Kind kind) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < probes.size(); ++i) {
+      if (probes[i].name == name) {
+        if (probes[i].kind != kind) {
+          throw ProfilingException()
+              << "Probe " << name << " registered as both a timer and a "
+              << "counter.";
+        }
+        return i;
+      }
+    }
+    if (probes.size() == kMaxProbes) {
+      throw ProfilingException()
+          << "Too many probes, cannot register " << name << ", at most "
+          << kMaxProbes << " are supported.";
+    }
+    probes.push_back({name, kind, {}});
+    return probes.size() - 1;
+  }
+
+  void Attach(ThreadProbes *t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(t);
+  }
+
+  // Keeps the totals of a thread that is exiting.
+  void Detach(ThreadProbes *t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < kMaxProbes; ++i) {
+      auto s = t->Get(i);
+      retired[i].calls += s.calls;
+      retired[i].total += s.total;
+    }
+    threads.erase(std::remove(threads.begin(), threads.end(), t),
+                  threads.end());
+  }
+
+  // Restarts the wall clock that rates are measured against.
+  void Start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    start = Clock::now();
+  }
+
+  double GetElapsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // The totals of one probe over every thread, exited or running.
+  ProbeStats GetStats(ProbeId id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ProbeStats stats = retired[id];
+    for (auto const *t : threads) {
+      auto s = t->Get(id);
+      stats.calls += s.calls;
+      stats.total += s.total;
+    }
+    return stats;
+  }
+
+  // The totals of every probe over every thread, exited or running.
+  std::vector<Probe> Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Probe> snapshot = probes;
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+      snapshot[i].stats = retired[i];
+      for (auto const *t : threads) {
+        auto s = t->Get(i);
+        snapshot[i].stats.calls += s.calls;
+        snapshot[i].stats.total += s.total;
+      }
+    }
+    return snapshot;
+  }
+
+  // The rates over the whole run, then every timer, by the time spent in it,
+  // and every counter. Timer totals are summed over threads, so with several
+  // threads they can add up to more than the wall time.
+  void WriteJSON(std::ostream &os) const {
+    double elapsed = GetElapsed();
+    auto snapshot = Snapshot();
+    uint64_t nevents = snapshot[kEvents].stats.total;
+    uint64_t nbytes = snapshot[kBytes].stats.total;
+    uint64_t nallocations = snapshot[kAllocations].stats.total;
+    auto PerEvent = [&](uint64_t n) {
+      return nevents ? double(n) / double(nevents) : 0.0;
+    };
+    auto PerSecond = [&](uint64_t n) {
+      return (elapsed > 0) ? double(n) / elapsed : 0.0;
+    };
+
+    std::vector<Probe> timers, counters;
+    for (size_t i = kAllocations + 1; i < snapshot.size(); ++i) {
+      if (!snapshot[i].stats.calls) {
+        continue;
+      }
+      (snapshot[i].kind == Kind::kTimer ? timers : counters)
+          .push_back(snapshot[i]);
+    }
+    std::stable_sort(timers.begin(), timers.end(),
+                     [](Probe const &a, Probe const &b) {
+                       return a.stats.total > b.stats.total;
+                     });
+
+    os << "{\n  \"wall_time_s\": " << elapsed << ",\n  \"events\": " << nevents
+       << ",\n  \"bytes\": " << nbytes
+       << ",\n  \"events_per_s\": " << PerSecond(nevents)
+       << ",\n  \"bytes_per_s\": " << PerSecond(nbytes)
+       << ",\n  \"allocations\": " << nallocations
+       << ",\n  \"allocations_per_event\": " << PerEvent(nallocations)
+       << ",\n  \"timers\": [";
+    for (size_t i = 0; i < timers.size(); ++i) {
+      auto const &s = timers[i].stats;
+      os << (i ? "," : "") << "\n    {\"name\": " << JSONQuote(timers[i].name)
+         << ", \"calls\": " << s.calls
+         << ", \"total_s\": " << (double(s.total) * 1E-9)
+         << ", \"mean_ns\": " << (double(s.total) / double(s.calls))
+         << ", \"fraction_of_wall\": "
+         << ((elapsed > 0) ? (double(s.total) * 1E-9 / elapsed) : 0.0)
+         << "}";
+    }
+    os << (timers.size() ? "\n  ]" : "]") << ",\n  \"counters\": [";
+    for (size_t i = 0; i < counters.size(); ++i) {
+      auto const &s = counters[i].stats;
+      os << (i ? "," : "") << "\n    {\"name\": "
+         << JSONQuote(counters[i].name) << ", \"calls\": " << s.calls
+         << ", \"total\": " << s.total
+         << ", \"per_event\": " << PerEvent(s.total) << "}";
+    }
+    os << (counters.size() ? "\n  ]" : "]") << "\n}" << std::endl;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  mutable std::mutex mutex;
+  Clock::time_point start = Clock::now();
+  std::vector<Probe> probes;
+  std::vector<ThreadProbes *> threads;
+  std::array<ProbeStats, kMaxProbes> retired{};
+
+  Profiler() {
+    probes.push_back({"Events", Kind::kCounter, {}});
+    probes.push_back({"Bytes", Kind::kCounter, {}});
+    probes.push_back({"Allocations", Kind::kCounter, {}});
+  }
+};
+
+inline ThreadProbes::ThreadProbes() { Profiler::Get().Attach(this); }
+
+inline ThreadProbes::~ThreadProbes() {
+  tls_probes = nullptr;
+  // Not recreated by anything that runs later in the exit of the thread.
+  tls_probes_busy = true;
+  Profiler::Get().Detach(this);
+}
+
+inline ProbeId Register(std::string const &name, Kind kind) {
+  return Profiler::Get().Register(name, kind);
+}
+
+inline void Add(ProbeId id, uint64_t amount) {
+  if (auto t = CurrentThreadProbes()) {
+    t->Add(id, amount);
+  }
+}
+
+inline void CountAllocation() {
+  if (auto t = CurrentThreadProbes(false)) {
+    t->Add(kAllocations, 1);
+  }
+}
+
+// The allocations counted so far on every thread. Allocations on a thread are
+// only counted once its probes exist, so this creates those of the calling
+// thread.
+inline uint64_t GetNAllocations() {
+  CurrentThreadProbes();
+  return Profiler::Get().GetStats(kAllocations).total;
+}
+
+class ScopedTimer {
+public:
+  explicit ScopedTimer(ProbeId id)
+      : id(id), start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    Add(id, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()));
+  }
+
+  ScopedTimer(ScopedTimer const &) = delete;
+  ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+private:
+  ProbeId id;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Prints the number of events processed so far and the recent event and
+// byte rates every interval seconds, on a background thread, until Stop.
+class ProgressReporter {
+public:
+  ProgressReporter(double interval, std::string label)
+      : interval(interval), label(std::move(label)) {
+    if (interval > 0) {
+      thread = std::thread([this]() { Run(); });
+    }
+  }
+
+  ProgressReporter(ProgressReporter const &) = delete;
+  ProgressReporter &operator=(ProgressReporter const &) = delete;
+
+  ~ProgressReporter() { Stop(); }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped = true;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+private:
+  double interval;
+  std::string label;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopped = false;
+  std::thread thread;
+
+  void Run() {
+    auto &profiler = Profiler::Get();
+    uint64_t last_events = 0, last_bytes = 0;
+    double last_elapsed = profiler.GetElapsed();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, std::chrono::duration<double>(interval),
+                          [this]() { return stopped; })) {
+      auto snapshot = profiler.Snapshot();
+      double elapsed = profiler.GetElapsed();
+      uint64_t nevents = snapshot[kEvents].stats.total;
+      uint64_t nbytes = snapshot[kBytes].stats.total;
+      double dt = elapsed - last_elapsed;
+
+      std::cout << "[INFO]: " << label << ": " << nevents << " events in "
+                << std::fixed << std::setprecision(1) << elapsed << " s, "
+                << std::setprecision(0) << (double(nevents - last_events) / dt)
+                << " evt/s";
+      if (nbytes) {
+        std::cout << ", " << std::setprecision(1)
+                  << (double(nbytes - last_bytes) / dt / 1E6) << " MB/s";
+      }
+      std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+
+      last_events = nevents;
+      last_bytes = nbytes;
+      last_elapsed = elapsed;
+    }
+  }
+};
+
+// The instrumentation of a run of a tool: restarts the Profiler clock, prints
+// progress every progress_interval seconds if it is positive, and writes the
+// JSON breakdown to report_file, if it is not empty, when it is destroyed.
+class Session {
+public:
+  Session(std::string report_file, double progress_interval,
+          std::string const &label)
+      : report_file(std::move(report_file)) {
+    Profiler::Get().Start();
+    progress = std::make_unique<ProgressReporter>(progress_interval, label);
+  }
+
+  ~Session() {
+    progress->Stop();
+    if (report_file.empty()) {
+      return;
+    }
+    std::ofstream os(report_file);
+    Profiler::Get().WriteJSON(os);
+    std::cout << "[INFO]: Wrote profile to " << report_file << std::endl;
+  }
+
+  Session(Session const &) = delete;
+  Session &operator=(Session const &) = delete;
+
+private:
+  std::string report_file;
+  std::unique_ptr<ProgressReporter> progress;
+};
+
+} // namespace Profiling
+} // namespace NuHepMC
+
+#define NuHepMC_PROFILE_CONCAT_IMPL(a, b) a##b
+#define NuHepMC_PROFILE_CONCAT(a, b) NuHepMC_PROFILE_CONCAT_IMPL(a, b)
+
+// Replaces the global operator new and delete with malloc and free, counting
+// each allocation. Must appear at most once in an executable.
+#define NuHepMC_COUNT_ALLOCATIONS()                                            \
+  void *operator new(std::size_t n) {                                          \
+    ::NuHepMC::Profiling::CountAllocation();                                   \
+    if (void *p = std::malloc(n ? n : 1)) {                                    \
+      return p;                                                                \
+    }                                                                          \
+    throw std::bad_alloc();                                                    \
+  }                                                                            \
+  void *operator new[](std::size_t n) { return ::operator new(n); }            \
+  void *operator new(std::size_t n, std::nothrow_t const &) noexcept {         \
+    ::NuHepMC::Profiling::CountAllocation();                                   \
+    return std::malloc(n ? n : 1);                                             \
+  }                                                                            \
+  void *operator new[](std::size_t n, std::nothrow_t const &t) noexcept {      \
+    return ::operator new(n, t);                                               \
+  }                                                                            \
+  void operator delete(void *p) noexcept { std::free(p); }                     \
+  void operator delete[](void *p) noexcept { std::free(p); }                   \
+  void operator delete(void *p, std::size_t) noexcept { std::free(p); }        \
+  void operator delete[](void *p, std::size_t) noexcept { std::free(p); }      \
+  void operator delete(void *p, std::nothrow_t const &) noexcept {             \
+    std::free(p);                                                              \
+  }                                                                            \
+  void operator delete[](void *p, std::nothrow_t const &) noexcept {           \
+    std::free(p);                                                              \
+  }
+
+#ifdef NuHepMC_ENABLE_PROFILING
+
+// Times the rest of the enclosing scope under the probe called name.
+#define NuHepMC_PROFILE_SCOPE(name)                                            \
+  static const ::NuHepMC::Profiling::ProbeId NuHepMC_PROFILE_CONCAT(           \
+      nuhepmc_probe_, __LINE__) = ::NuHepMC::Profiling::Register(              \
+      name, ::NuHepMC::Profiling::Kind::kTimer);                               \
+  ::NuHepMC::Profiling::ScopedTimer NuHepMC_PROFILE_CONCAT(nuhepmc_timer_,     \
+                                                           __LINE__)(          \
+      NuHepMC_PROFILE_CONCAT(nuhepmc_probe_, __LINE__))
+
+// Times the rest of the enclosing scope under a probe registered
+// beforehand, for probes whose names are only known at run time.
+#define NuHepMC_PROFILE_TIMER(id)                                              \
+  ::NuHepMC::Profiling::ScopedTimer NuHepMC_PROFILE_CONCAT(nuhepmc_timer_,     \
+                                                           __LINE__)(id)
+
+#define NuHepMC_PROFILE_COUNT(name, n)                                         \
+  do {                                                                         \
+    static const ::NuHepMC::Profiling::ProbeId nuhepmc_probe =                 \
+        ::NuHepMC::Profiling::Register(                                        \
+            name, ::NuHepMC::Profiling::Kind::kCounter);                       \
+    ::NuHepMC::Profiling::Add(nuhepmc_probe, uint64_t(n));                     \
+  } while (0)
+
+#define NuHepMC_PROFILE_EVENTS(nevents, nbytes)                                \
+  do {                                                                         \
+    ::NuHepMC::Profiling::Add(::NuHepMC::Profiling::kEvents,                   \
+                              uint64_t(nevents));                              \
+    ::NuHepMC::Profiling::Add(::NuHepMC::Profiling::kBytes, uint64_t(nbytes)); \
+  } while (0)
+
+// Counts each allocation when profiling is enabled.
+#define NuHepMC_PROFILE_ALLOCATIONS() NuHepMC_COUNT_ALLOCATIONS()
+
+#else
+
+#define NuHepMC_PROFILE_SCOPE(name) static_cast<void>(0)
+#define NuHepMC_PROFILE_TIMER(id) static_cast<void>(0)
+#define NuHepMC_PROFILE_COUNT(name, n) static_cast<void>(0)
+#define NuHepMC_PROFILE_EVENTS(nevents, nbytes) static_cast<void>(0)
+#define NuHepMC_PROFILE_ALLOCATIONS()
+
+#endif
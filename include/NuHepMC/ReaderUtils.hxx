@@ -8,12 +8,15 @@
 
 #include "NuHepMC/Constants.hxx"
 #include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/Profiling.hxx"
 #include "NuHepMC/Types.hxx"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace NuHepMC {
@@ -28,12 +31,10 @@ template <typename T> bool HasAttribute(T const &obj, std::string const &name) {
          attr_names.end();
 }
 
+// Throws the exception appropriate for an attribute that could not be
+// retrieved as an AT: either it is missing, or it cannot be parsed as an AT.
 template <typename AT, typename T>
-auto CheckedAttributeValue(T const &obj, std::string const &name) {
-  if (!obj) {
-    throw NullObjectException();
-  }
-
+[[noreturn]] void ThrowAttributeError(T const &obj, std::string const &name) {
   if (!HasAttribute(obj, name)) {
     MissingAttributeException mae;
     mae << "Failed to find attribute: " << name;
@@ -44,33 +45,105 @@ auto CheckedAttributeValue(T const &obj, std::string const &name) {
     throw mae;
   }
 
-  if (!obj->template attribute<AT>(name)) {
-    throw AttributeTypeException()
-        << name << ": " << obj->attribute_as_string(name);
+  throw AttributeTypeException()
+      << name << ": " << obj->attribute_as_string(name);
+}
+
+template <typename AT, typename T>
+std::shared_ptr<AT> CheckedAttribute(T const &obj, std::string const &name) {
+  NuHepMC_PROFILE_SCOPE("Attributes.CheckedAttributeValue");
+  if (!obj) {
+    throw NullObjectException();
   }
 
-  return obj->template attribute<AT>(name)->value();
+  auto attr = obj->template attribute<AT>(name);
+  if (!attr) {
+    ThrowAttributeError<AT>(obj, name);
+  }
+  return attr;
+}
+
+template <typename AT, typename T>
+auto CheckedAttributeValue(T const &obj, std::string const &name) {
+  return CheckedAttribute<AT>(obj, name)->value();
 }
 
 template <typename AT, typename T>
 auto CheckedAttributeValue(T const &obj, std::string const &name,
                            decltype(obj->template attribute<AT>(name)->value())
                                const defval) {
+  NuHepMC_PROFILE_SCOPE("Attributes.CheckedAttributeValue");
   if (!obj) {
     throw NullObjectException();
   }
 
-  if (!HasAttribute(obj, name)) {
-    return defval;
+  auto attr = obj->template attribute<AT>(name);
+  if (!attr) {
+    if (!HasAttribute(obj, name)) {
+      return defval;
+    }
+    ThrowAttributeError<AT>(obj, name);
   }
 
-  if (!obj->template attribute<AT>(name)) {
-    throw AttributeTypeException()
-        << name << ": " << obj->attribute_as_string(name);
+  return attr->value();
+}
+
+// A named attribute accessor intended to be constructed once, e.g. after the
+// run info has been read, and then used for every event. Each access is a
+// single lookup of the stored name, which parses the attribute at most once
+// per object, and no temporary keys or name lists are built unless the
+// attribute is missing or has the wrong type. The error semantics are those
+// of CheckedAttributeValue.
+//
+//   NuHepMC::AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+//   while (reader->read_event(evt)) { int pid = ProcID.Value(&evt); ... }
+template <typename AT> class AttributeHandle {
+public:
+  using value_type = decltype(std::declval<AT>().value());
+
+  explicit AttributeHandle(std::string name) : name(std::move(name)) {}
+
+  std::string const &GetName() const { return name; }
+
+  // Returns nullptr if the attribute is missing or cannot be parsed as an AT.
+  template <typename T> std::shared_ptr<AT> Get(T const &obj) const {
+    NuHepMC_PROFILE_SCOPE("Attributes.AttributeHandle");
+    if (!obj) {
+      throw NullObjectException();
+    }
+    return obj->template attribute<AT>(name);
   }
 
-  return obj->template attribute<AT>(name)->value();
-}
+  template <typename T> bool Has(T const &obj) const {
+    return bool(Get(obj));
+  }
+
+  // Throws MissingAttributeException or AttributeTypeException
+  template <typename T> value_type Value(T const &obj) const {
+    auto attr = Get(obj);
+    if (!attr) {
+      ThrowAttributeError<AT>(obj, name);
+    }
+    return attr->value();
+  }
+
+  // Returns defval if the attribute is missing, throws AttributeTypeException
+  // if it is present with the wrong type.
+  template <typename T>
+  value_type Value(T const &obj, value_type const &defval) const {
+    auto attr = Get(obj);
+    if (!attr) {
+      if (!HasAttribute(obj, name)) {
+        return defval;
+      }
+      ThrowAttributeError<AT>(obj, name);
+    }
+    return attr->value();
+  }
+
+private:
+  std::string name;
+};
 
 namespace GenRunInfo {
 
@@ -137,6 +210,9 @@ ReadConventions(std::shared_ptr<HepMC3::GenRunInfo> &run_info) {
 } // namespace GenRunInfo
 
 namespace GenEvent {
+// Scans every vertex, code that needs the primary vertex, beam, target or
+// final-state particles of an event more than once should build a
+// NuHepMC::EventView instead.
 HepMC3::ConstGenVertexPtr GetPrimaryVertex(HepMC3::GenEvent const &evt) {
 
   for (auto const &vtx : evt.vertices()) {
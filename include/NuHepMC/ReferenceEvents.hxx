@@ -0,0 +1,227 @@
+#pragma once
+
+#include "NuHepMC/Constants.hxx"
+#include "NuHepMC/EventBuilder.hxx"
+#include "NuHepMC/WriterUtils.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/FourVector.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
+#include "HepMC3/GenVertex.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+// The run info and events written by NuHepMCReferenceWriter, an example of
+// each of the NuHepMC requirements and of the conventions that it declares.
+// The same layout, with the size and shape of each event varied, is used to
+// generate events for the benchmarks.
+namespace Reference {
+
+// E.C.4
+const double cm2_to_pb = 1E36;
+
+namespace VertexStatus {
+const int kFSIAbs = 2;
+}
+namespace ParticleStatus {
+const int kFSIState = 21;
+}
+
+// G.R.4
+inline std::map<int, std::pair<std::string, std::string>> ProcessIDs() {
+  return {
+      {200, {"CCQE", "The Moon QE Model -- PRD 1234 (1990)"}}, // G.C.5
+      {250, {"NCQE", "The Moon QE Model -- PRD 1234 (1990)"}}, // G.C.5
+      {300, {"MEC", "My Shiny MEC Model -- PRL 1 (1950)"}},    // G.C.5
+      {500, {"Single PiPlus Production", "PiPlus 2049"}},
+      {600, {"DIS", "Badabing Badaboom"}},
+  };
+}
+
+inline std::shared_ptr<HepMC3::GenRunInfo> BuildGenRunInfo(
+    std::map<int, std::pair<std::string, std::string>> const &process_ids =
+        ProcessIDs(),
+    std::vector<std::string> const &weight_names = {"CV"},
+    int nevents = 3) {
+  // G.R.1
+  std::shared_ptr<HepMC3::GenRunInfo> run_info =
+      std::make_shared<HepMC3::GenRunInfo>();
+
+  // G.R.1
+  NuHepMC::GenRunInfo::WriteNuHepMCVersion(run_info);
+
+  // G.R.3
+  run_info->tools().emplace_back(
+      HepMC3::GenRunInfo::ToolInfo{"MyGen", "0.0.1", "My Favorite Generator"});
+
+  // G.R.4
+  NuHepMC::GenRunInfo::WriteProcessIDDefinitions(run_info, process_ids);
+
+  // G.R.5
+  std::map<int, std::pair<std::string, std::string>> VertexStatuses = {
+      {NuHepMC::VertexStatus::kPrimaryVertex,
+       {"PrimVer", "The primary vertex or hard scatter"}},
+      {VertexStatus::kFSIAbs, {"FSIAbs", "Final state absorption interaction"}},
+  };
+  NuHepMC::GenRunInfo::WriteVertexStatusIDDefinitions(run_info, VertexStatuses);
+
+  // G.R.6
+  std::map<int, std::pair<std::string, std::string>> ParticleStatuses = {
+      {NuHepMC::ParticleStatus::kUndecayedPhysicalParticle,
+       {"FinalState", "Undecayed physical particle"}},
+      {NuHepMC::ParticleStatus::kIncomingBeamParticle,
+       {"InitialState", "Incoming beam particle"}},
+      {ParticleStatus::kFSIState, {"FSI", "Final state interaction steps"}},
+  };
+  NuHepMC::GenRunInfo::WriteParticleStatusIDDefinitions(run_info,
+                                                        ParticleStatuses);
+
+  // G.R.7
+  run_info->set_weight_names(weight_names);
+
+  // G.C.1
+  run_info->add_attribute(
+      "NuHepMC.Conventions",
+      std::make_shared<HepMC3::VectorStringAttribute>(
+          std::vector<std::string>{"G.C.1", "G.C.2", "G.C.4", "G.C.5", "E.C.1",
+                                   "E.C.2", "E.C.3", "E.C.5", "E.C.6"}));
+
+  // G.C.2
+  run_info->add_attribute("NuHepMC.Exposure.NEvents",
+                          std::make_shared<HepMC3::IntAttribute>(nevents));
+
+  // G.C.4
+  run_info->add_attribute(
+      "NuHepMC.FluxAveragedTotalCrossSection",
+      std::make_shared<HepMC3::DoubleAttribute>(1.234E-38 * cm2_to_pb));
+
+  return run_info;
+}
+
+struct Particle {
+  HepMC3::FourVector momentum;
+  int pid;
+  double mass;
+};
+
+// The particles of an event laid out as the reference event is: a target
+// nucleon and a beam neutrino enter the primary vertex and the products leave
+// it. If fsi is not empty, the last product rescatters through one FSI vertex
+// per entry of fsi, each producing the next particle of fsi, the last of which
+// leaves the nucleus.
+struct EventContent {
+  Particle target;
+  Particle beam;
+  std::vector<Particle> products;
+  std::vector<Particle> fsi;
+  // E.C.5, E.R.4
+  std::vector<double> LabPos = {0, 0, 0, 0};
+};
+
+// The content of each event written by NuHepMCReferenceWriter: a CCQE-like
+// numu interaction on a neutron with a final state pi+ that is absorbed,
+// leaving a second proton.
+inline EventContent const &ReferenceEventContent() {
+  static const EventContent content = {
+      {HepMC3::FourVector{1.5255172492130473e+02, 8.9392830847276528e+01,
+                          6.4870597568257821e+01, 9.5825554558124941e+02},
+       2112, 9.3956499999999994e+02},
+      {HepMC3::FourVector{0.0000000000000000e+00, 0.0000000000000000e+00,
+                          1.5000000000000000e+03, 1.5000000000000000e+03},
+       14, 0.0000000000000000e+00},
+      {{HepMC3::FourVector{-6.8928697531845643e+01, 4.8219068401438176e+02,
+                           1.2406574501351240e+03, 1.3370316161682497e+03},
+        13, 1.0565800000000023e+02},
+       {HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
+                           3.2421314743313258e+02, 1.0903266675337304e+03},
+        2212, 9.3827200000000005e+02},
+       {HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
+                           3.2421314743313258e+02, 1.0903266675337304e+03},
+        211, 1.3957039000000000e+02}},
+      {{HepMC3::FourVector{2.2148042245314980e+02, -3.9279785316710411e+02,
+                           3.2421314743313258e+02, 1.0903266675337304e+03},
+        2212, 9.3827200000000005e+02}},
+      {0, 0, 0, 0},
+  };
+  return content;
+}
+
+// Fills evt, which is reset first, with content. The caller sets the event
+// number (E.R.1), the ProcID (E.R.2) and any weights other than CV.
+inline void BuildEvent(EventBuilder const &builder, EventContent const &content,
+                       HepMC3::GenEvent &evt) {
+  // E.R.3
+  builder.Reset(evt);
+  // E.C.1
+  builder.SetCVWeight(evt, 1);
+
+  // E.C.2
+  builder.SetTotXS(evt, 1.2E-36 * cm2_to_pb);
+  // E.C.3
+  builder.SetProcXS(evt, 0.8E-36 * cm2_to_pb);
+
+  // E.R.4
+  builder.SetLabPos(evt, content.LabPos);
+
+  auto MakeParticle = [&](Particle const &p, int status) {
+    HepMC3::GenParticlePtr part = builder.Particle(p.momentum, p.pid, status);
+    part->set_generated_mass(p.mass);
+    return part;
+  };
+
+  // E.R.5
+  HepMC3::GenVertexPtr primvertex = builder.PrimaryVertex();
+  primvertex->add_particle_in(MakeParticle(
+      content.target, NuHepMC::ParticleStatus::kTargetParticle));
+  // E.R.6
+  primvertex->add_particle_in(MakeParticle(
+      content.beam, NuHepMC::ParticleStatus::kIncomingBeamParticle));
+
+  HepMC3::GenParticlePtr last;
+  for (size_t i = 0; i < content.products.size(); ++i) {
+    bool rescatters =
+        content.fsi.size() && ((i + 1) == content.products.size());
+    last = MakeParticle(
+        content.products[i],
+        rescatters ? ParticleStatus::kFSIState
+                   : NuHepMC::ParticleStatus::kUndecayedPhysicalParticle);
+    primvertex->add_particle_out(last);
+  }
+  evt.add_vertex(primvertex);
+
+  if (!last) {
+    return;
+  }
+
+  for (size_t d = 0; d < content.fsi.size(); ++d) {
+    bool final_step = ((d + 1) == content.fsi.size());
+    double scale = 1E-10 * (d + 1);
+    // V.R.1
+    HepMC3::GenVertexPtr fsivertex = builder.Vertex(
+        HepMC3::FourVector{1 * scale, 2 * scale, 3 * scale, 4 * scale},
+        VertexStatus::kFSIAbs);
+    fsivertex->add_particle_in(last);
+
+    last = MakeParticle(
+        content.fsi[d],
+        final_step ? NuHepMC::ParticleStatus::kUndecayedPhysicalParticle
+                   : ParticleStatus::kFSIState);
+    fsivertex->add_particle_out(last);
+    evt.add_vertex(fsivertex);
+  }
+}
+
+inline void BuildEvent(EventBuilder const &builder, HepMC3::GenEvent &evt) {
+  BuildEvent(builder, ReferenceEventContent(), evt);
+}
+
+} // namespace Reference
+} // namespace NuHepMC
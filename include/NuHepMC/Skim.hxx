@@ -0,0 +1,563 @@
+#pragma once
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/EventView.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenParticle.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(SkimException);
+
+// Event selection for skimming files, e.g.
+//
+//   ProcID in {200, 300} && any(pdg == 211 && status == 1)
+//   count(abspdg == 211 && status == 1) >= 2 || TotXS > 1E-38
+//
+// expressions combine comparisons with &&, || and ! and may be grouped with
+// parentheses. The event variables are
+//   ProcID, evnum, TotXS (E.C.2), ProcXS (E.C.3), LabPos[0-3] (E.C.5)
+// and a comparison against an attribute that the event does not have is
+// false. any(p) and count(p) range over the particles of the event, where p
+// is an expression over the particle variables
+//   pdg, abspdg, status, px, py, pz, e, mass.
+// Comparisons are ==, !=, <, <=, > and >=, and var in {a, b, ...} tests
+// membership.
+//
+// Predicates are evaluated on an EventRecord, which holds only the parts of
+// an event that the predicate needs and can be filled either from the text
+// of an Asciiv3 event, without building a HepMC3::GenEvent, or from a
+// GenEvent.
+namespace Skim {
+
+enum Var {
+  // event variables
+  kProcID,
+  kEvNum,
+  kTotXS,
+  kProcXS,
+  kLabPos0,
+  kLabPos1,
+  kLabPos2,
+  kLabPos3,
+  kNEventVars,
+  // particle variables
+  kPDG = kNEventVars,
+  kAbsPDG,
+  kStatus,
+  kPx,
+  kPy,
+  kPz,
+  kE,
+  kMass,
+  kNVars
+};
+
+namespace Needs {
+const uint32_t kAttributes = (1 << 0);
+const uint32_t kParticles = (1 << 1);
+} // namespace Needs
+
+struct Particle {
+  double values[kNVars - kNEventVars];
+  double Get(int var) const { return values[var - kNEventVars]; }
+};
+
+struct EventRecord {
+  double values[kNEventVars];
+  bool present[kNEventVars];
+  std::vector<Particle> particles;
+
+  // Scratch space for FillEventRecord(HepMC3::GenEvent const &, ...)
+  EventView view;
+
+  void Clear() {
+    for (int i = 0; i < kNEventVars; ++i) {
+      present[i] = false;
+    }
+    particles.clear();
+  }
+
+  void Set(int var, double v) {
+    values[var] = v;
+    present[var] = true;
+  }
+};
+
+inline void FillEventRecord(RawEvent const &evt, uint32_t needs,
+                            EventRecord &r) {
+  r.Clear();
+  r.Set(kEvNum, evt.evnum);
+
+  evt.ForEachLine([&](char const *line, char const *eol) {
+    char const *p = line + 1;
+    switch (*line) {
+    case 'A': {
+      long id;
+      if (!(needs & Needs::kAttributes) || !Ascii::ParseInt(p, eol, id) ||
+          id) {
+        return;
+      }
+      p = Ascii::SkipBlanks(p, eol);
+      char const *name_end = Ascii::TokenEnd(p, eol);
+      auto IsName = [&](char const *name, size_t len) {
+        return (size_t(name_end - p) == len) && !std::memcmp(p, name, len);
+      };
+
+      double v = 0;
+      if (IsName("ProcID", 6)) {
+        long procid = 0;
+        p = name_end;
+        if (Ascii::ParseInt(p, eol, procid)) {
+          r.Set(kProcID, double(procid));
+        }
+      } else if (IsName("TotXS", 5)) {
+        p = name_end;
+        if (Ascii::ParseDouble(p, eol, v)) {
+          r.Set(kTotXS, v);
+        }
+      } else if (IsName("ProcXS", 6)) {
+        p = name_end;
+        if (Ascii::ParseDouble(p, eol, v)) {
+          r.Set(kProcXS, v);
+        }
+      } else if (IsName("LabPos", 6)) {
+        p = name_end;
+        for (int i = 0; (i < 4) && Ascii::ParseDouble(p, eol, v); ++i) {
+          r.Set(kLabPos0 + i, v);
+        }
+      }
+      return;
+    }
+    case 'P': {
+      if (!(needs & Needs::kParticles)) {
+        return;
+      }
+      // P id parent pid px py pz e m status
+      long pid = 0, status = 0;
+      Particle part;
+      Ascii::SkipToken(p, eol);
+      Ascii::SkipToken(p, eol);
+      Ascii::ParseInt(p, eol, pid);
+      for (int var : {kPx, kPy, kPz, kE, kMass}) {
+        double v = 0;
+        Ascii::ParseDouble(p, eol, v);
+        part.values[var - kNEventVars] = v;
+      }
+      Ascii::ParseInt(p, eol, status);
+      part.values[kPDG - kNEventVars] = double(pid);
+      part.values[kAbsPDG - kNEventVars] = double(std::labs(pid));
+      part.values[kStatus - kNEventVars] = double(status);
+      r.particles.push_back(part);
+      return;
+    }
+    default: {
+      return;
+    }
+    }
+  });
+}
+
+inline void FillEventRecord(HepMC3::GenEvent const &evt, uint32_t needs,
+                            EventRecord &r) {
+  static const AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+  static const AttributeHandle<HepMC3::DoubleAttribute> TotXS("TotXS");
+  static const AttributeHandle<HepMC3::DoubleAttribute> ProcXS("ProcXS");
+  static const AttributeHandle<HepMC3::VectorDoubleAttribute> LabPos("LabPos");
+
+  r.Clear();
+  r.Set(kEvNum, evt.event_number());
+
+  if (needs & Needs::kAttributes) {
+    if (auto attr = ProcID.Get(&evt)) {
+      r.Set(kProcID, attr->value());
+    }
+    if (auto attr = TotXS.Get(&evt)) {
+      r.Set(kTotXS, attr->value());
+    }
+    if (auto attr = ProcXS.Get(&evt)) {
+      r.Set(kProcXS, attr->value());
+    }
+    if (auto attr = LabPos.Get(&evt)) {
+      auto pos = attr->value();
+      for (size_t i = 0; (i < 4) && (i < pos.size()); ++i) {
+        r.Set(kLabPos0 + int(i), pos[i]);
+      }
+    }
+  }
+
+  if (needs & Needs::kParticles) {
+    auto const &view = r.view;
+    r.view.Fill(evt);
+    for (size_t i = 0; i < view.NParticles(); ++i) {
+      Particle p;
+      p.values[kPDG - kNEventVars] = view.pid[i];
+      p.values[kAbsPDG - kNEventVars] = std::abs(view.pid[i]);
+      p.values[kStatus - kNEventVars] = view.status[i];
+      p.values[kPx - kNEventVars] = view.px[i];
+      p.values[kPy - kNEventVars] = view.py[i];
+      p.values[kPz - kNEventVars] = view.pz[i];
+      p.values[kE - kNEventVars] = view.e[i];
+      p.values[kMass - kNEventVars] = view.generated_mass[i];
+      r.particles.push_back(p);
+    }
+  }
+}
+
+class Predicate {
+public:
+  // Throws SkimException, pointing at the offending character, if expr
+  // cannot be parsed.
+  static Predicate Parse(std::string const &expr) {
+    Predicate pred;
+    Parser parser{expr, 0, pred.nodes, pred.needs};
+    pred.root = parser.ParseOr(false);
+    parser.SkipSpace();
+    if (parser.pos != expr.size()) {
+      parser.Fail("unexpected trailing input");
+    }
+    return pred;
+  }
+
+  bool operator()(EventRecord const &r) const {
+    return Eval(root, r, nullptr);
+  }
+
+  // The Needs bits of the EventRecord fields that the predicate reads.
+  uint32_t GetNeeds() const { return needs; }
+
+private:
+  enum Op { kEq, kNe, kLt, kLe, kGt, kGe };
+
+  struct Node {
+    enum Kind { kOr, kAnd, kNot, kCompare, kIn, kCount } kind;
+    // children, for kOr, kAnd, kNot and kCount
+    std::vector<int> args;
+    int var = 0;
+    Op op = kEq;
+    double value = 0;
+    // for kIn
+    std::vector<double> set;
+  };
+
+  std::vector<Node> nodes;
+  int root = -1;
+  uint32_t needs = 0;
+
+  static bool Compare(double a, Op op, double b) {
+    switch (op) {
+    case kEq:
+      return a == b;
+    case kNe:
+      return a != b;
+    case kLt:
+      return a < b;
+    case kLe:
+      return a <= b;
+    case kGt:
+      return a > b;
+    case kGe:
+      return a >= b;
+    }
+    return false;
+  }
+
+  bool Eval(int i, EventRecord const &r, Particle const *part) const {
+    Node const &n = nodes[size_t(i)];
+    switch (n.kind) {
+    case Node::kOr: {
+      for (int a : n.args) {
+        if (Eval(a, r, part)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case Node::kAnd: {
+      for (int a : n.args) {
+        if (!Eval(a, r, part)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case Node::kNot: {
+      return !Eval(n.args.front(), r, part);
+    }
+    case Node::kCompare:
+    case Node::kIn: {
+      double v;
+      if (n.var < kNEventVars) {
+        if (!r.present[n.var]) {
+          return false;
+        }
+        v = r.values[n.var];
+      } else {
+        v = part->Get(n.var);
+      }
+      if (n.kind == Node::kCompare) {
+        return Compare(v, n.op, n.value);
+      }
+      for (double s : n.set) {
+        if (v == s) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case Node::kCount: {
+      size_t count = 0;
+      for (auto const &p : r.particles) {
+        count += Eval(n.args.front(), r, &p);
+      }
+      return Compare(double(count), n.op, n.value);
+    }
+    }
+    return false;
+  }
+
+  struct Parser {
+    std::string const &expr;
+    size_t pos;
+    std::vector<Node> &nodes;
+    uint32_t &needs;
+
+    [[noreturn]] void Fail(std::string const &why) const {
+      throw SkimException() << "Failed to parse selection, " << why
+                            << " at position " << pos << ":\n\t" << expr
+                            << "\n\t" << std::string(pos, ' ') << "^";
+    }
+
+    void SkipSpace() {
+      while ((pos < expr.size()) && std::isspace((unsigned char)expr[pos])) {
+        pos++;
+      }
+    }
+
+    bool Accept(char const *tok) {
+      SkipSpace();
+      size_t len = std::strlen(tok);
+      if (!expr.compare(pos, len, tok)) {
+        pos += len;
+        return true;
+      }
+      return false;
+    }
+
+    void Expect(char const *tok) {
+      if (!Accept(tok)) {
+        Fail(std::string("expected \"") + tok + "\"");
+      }
+    }
+
+    std::string Identifier() {
+      SkipSpace();
+      size_t begin = pos;
+      if ((pos < expr.size()) && std::isdigit((unsigned char)expr[pos])) {
+        return "";
+      }
+      while ((pos < expr.size()) &&
+             (std::isalnum((unsigned char)expr[pos]) || (expr[pos] == '_'))) {
+        pos++;
+      }
+      return expr.substr(begin, pos - begin);
+    }
+
+    double Number() {
+      SkipSpace();
+      char const *begin = expr.c_str() + pos;
+      char *end;
+      double v = std::strtod(begin, &end);
+      if (end == begin) {
+        Fail("expected a number");
+      }
+      pos += size_t(end - begin);
+      return v;
+    }
+
+    Op ParseOp() {
+      // two-character operators first
+      if (Accept("==")) {
+        return kEq;
+      } else if (Accept("!=")) {
+        return kNe;
+      } else if (Accept("<=")) {
+        return kLe;
+      } else if (Accept(">=")) {
+        return kGe;
+      } else if (Accept("<")) {
+        return kLt;
+      } else if (Accept(">")) {
+        return kGt;
+      }
+      Fail("expected a comparison operator");
+    }
+
+    int Add(Node n) {
+      nodes.push_back(std::move(n));
+      return int(nodes.size()) - 1;
+    }
+
+    int ParseOr(bool in_particle) {
+      Node n;
+      n.kind = Node::kOr;
+      n.args.push_back(ParseAnd(in_particle));
+      while (Accept("||")) {
+        n.args.push_back(ParseAnd(in_particle));
+      }
+      return (n.args.size() == 1) ? n.args.front() : Add(std::move(n));
+    }
+
+    int ParseAnd(bool in_particle) {
+      Node n;
+      n.kind = Node::kAnd;
+      n.args.push_back(ParseUnary(in_particle));
+      while (Accept("&&")) {
+        n.args.push_back(ParseUnary(in_particle));
+      }
+      return (n.args.size() == 1) ? n.args.front() : Add(std::move(n));
+    }
+
+    int ParseUnary(bool in_particle) {
+      SkipSpace();
+      // ! but not !=
+      if ((pos < expr.size()) && (expr[pos] == '!') &&
+          expr.compare(pos, 2, "!=")) {
+        pos++;
+        Node n;
+        n.kind = Node::kNot;
+        n.args.push_back(ParseUnary(in_particle));
+        return Add(std::move(n));
+      }
+      if (Accept("(")) {
+        int inner = ParseOr(in_particle);
+        Expect(")");
+        return inner;
+      }
+
+      size_t ident_pos = pos;
+      std::string ident = Identifier();
+      if (ident.empty()) {
+        Fail("expected a variable, any(...), count(...), ! or (");
+      }
+
+      if ((ident == "any") || (ident == "count")) {
+        if (in_particle) {
+          pos = ident_pos;
+          Fail(ident + "(...) cannot be nested");
+        }
+        needs |= Needs::kParticles;
+        Node n;
+        n.kind = Node::kCount;
+        Expect("(");
+        n.args.push_back(ParseOr(true));
+        Expect(")");
+        if (ident == "any") {
+          n.op = kGe;
+          n.value = 1;
+        } else {
+          n.op = ParseOp();
+          n.value = Number();
+        }
+        return Add(std::move(n));
+      }
+
+      Node n;
+      n.kind = Node::kCompare;
+      n.var = LookupVar(ident, in_particle, ident_pos);
+      if (n.var < kNEventVars) {
+        needs |= Needs::kAttributes;
+      }
+      if (Accept("in")) {
+        n.kind = Node::kIn;
+        Expect("{");
+        n.set.push_back(Number());
+        while (Accept(",")) {
+          n.set.push_back(Number());
+        }
+        Expect("}");
+      } else {
+        n.op = ParseOp();
+        n.value = Number();
+      }
+      return Add(std::move(n));
+    }
+
+    int LookupVar(std::string const &ident, bool in_particle,
+                  size_t ident_pos) {
+      if (in_particle) {
+        static char const *const names[] = {"pdg", "abspdg", "status", "px",
+                                            "py",  "pz",     "e",      "mass"};
+        for (int i = 0; i < (kNVars - kNEventVars); ++i) {
+          if (ident == names[i]) {
+            return kNEventVars + i;
+          }
+        }
+        pos = ident_pos;
+        Fail("unknown particle variable \"" + ident + "\"");
+      }
+
+      if (ident == "ProcID") {
+        return kProcID;
+      } else if (ident == "evnum") {
+        return kEvNum;
+      } else if (ident == "TotXS") {
+        return kTotXS;
+      } else if (ident == "ProcXS") {
+        return kProcXS;
+      } else if (ident == "LabPos") {
+        Expect("[");
+        double i = Number();
+        if ((i != 0) && (i != 1) && (i != 2) && (i != 3)) {
+          Fail("LabPos index must be 0, 1, 2 or 3");
+        }
+        Expect("]");
+        return kLabPos0 + int(i);
+      }
+      pos = ident_pos;
+      Fail("unknown event variable \"" + ident +
+           "\", particle variables are only allowed inside any(...) or "
+           "count(...)");
+    }
+  };
+};
+
+// The run info of a skim that kept nselected of ninput events: the exposure
+// in events (G.C.3) becomes nselected and the flux-averaged total cross
+// section (G.C.4) is scaled by nselected / ninput, so that FATX / NEvents,
+// and so the cross section estimated from the weights of the kept events, is
+// unchanged. The POT and livetime exposure of the input are kept.
+inline std::shared_ptr<HepMC3::GenRunInfo>
+SkimRunInfo(std::shared_ptr<HepMC3::GenRunInfo> const &run_info,
+            size_t ninput, size_t nselected) {
+  auto skimmed = std::make_shared<HepMC3::GenRunInfo>(*run_info);
+  skimmed->add_attribute("NuHepMC.Exposure.NEvents",
+                         std::make_shared<HepMC3::LongAttribute>(
+                             long(nselected)));
+
+  double fatx = CheckedAttributeValue<HepMC3::DoubleAttribute>(
+      run_info, "NuHepMC.FluxAveragedTotalCrossSection", -1);
+  if ((fatx != -1) && ninput) {
+    skimmed->add_attribute("NuHepMC.FluxAveragedTotalCrossSection",
+                           std::make_shared<HepMC3::DoubleAttribute>(
+                               fatx * double(nselected) / double(ninput)));
+  }
+  return skimmed;
+}
+
+} // namespace Skim
+} // namespace NuHepMC
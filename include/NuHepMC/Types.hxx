@@ -1,9 +1,65 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace NuHepMC {
 using StatusCodeDescriptors =
     std::map<int, std::pair<std::string, std::string>>;
-}
\ No newline at end of file
+
+// The set of codes declared in a StatusCodeDescriptors, for checks that look
+// up a code for every particle or vertex. Declared codes are normally a small,
+// dense range, which is stored as a table of flags indexed by code so that a
+// lookup is a subtraction and a load rather than a walk down a tree. Widely
+// spread codes fall back to a binary search of a sorted array.
+class StatusCodeLookup {
+public:
+  StatusCodeLookup() = default;
+
+  // Implicit, so that a StatusCodeDescriptors can be used wherever a lookup
+  // is expected.
+  StatusCodeLookup(StatusCodeDescriptors const &descriptors) {
+    if (descriptors.empty()) {
+      return;
+    }
+    int64_t lo = descriptors.begin()->first;
+    int64_t hi = descriptors.rbegin()->first;
+    if ((hi - lo) < kMaxTableSize) {
+      first = lo;
+      table.assign(size_t(hi - lo + 1), 0);
+      for (auto const &d : descriptors) {
+        table[size_t(d.first - lo)] = 1;
+      }
+    } else {
+      for (auto const &d : descriptors) {
+        sparse.push_back(d.first);
+      }
+    }
+    ncodes = descriptors.size();
+  }
+
+  // Returns 1 if code is declared and 0 otherwise, like std::map::count.
+  size_t count(int code) const {
+    if (sparse.size()) {
+      return std::binary_search(sparse.begin(), sparse.end(), code);
+    }
+    // codes below first wrap around to beyond the end of the table
+    size_t i = size_t(int64_t(code) - first);
+    return (i < table.size()) ? table[i] : 0;
+  }
+
+  size_t size() const { return ncodes; }
+  bool empty() const { return !ncodes; }
+
+private:
+  static constexpr int64_t kMaxTableSize = 1 << 16;
+
+  int64_t first = 0;
+  std::vector<uint8_t> table;
+  std::vector<int> sparse;
+  size_t ncodes = 0;
+};
+} // namespace NuHepMC
@@ -0,0 +1,818 @@
+#pragma once
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/BinaryIO.hxx"
+#include "NuHepMC/Constants.hxx"
+#include "NuHepMC/JSONUtils.hxx"
+#include "NuHepMC/Profiling.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+#include "NuHepMC/Types.hxx"
+
+#include "HepMC3/GenEvent.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace NuHepMC {
+namespace Validation {
+
+// The run-level definitions that event-level rules check against, reduced to
+// flat lookups of the declared codes, which the rules look up once per event,
+// vertex or particle.
+struct RunDefinitions {
+  StatusCodeLookup ProcessIds;
+  StatusCodeLookup VertexStatuses;
+  StatusCodeLookup ParticleStatuses;
+};
+
+// Why an attribute could not be read. The message for a failure is only
+// built when the failure is described, by DescribeAttributeError.
+enum class AttributeError { kNone, kMissing, kWrongType };
+
+template <typename T> struct AttributeField {
+  bool ok = false;
+  T value{};
+  AttributeError error = AttributeError::kNone;
+};
+
+// Bits in the Rule::needs mask, each one names a group of EventFields members
+// that must be filled before a rule can be checked.
+namespace Needs {
+const uint32_t kProcID = 1 << 0;
+const uint32_t kLabPos = 1 << 1;
+const uint32_t kTotXS = 1 << 2;
+const uint32_t kProcXS = 1 << 3;
+const uint32_t kCrossSection = 1 << 4;
+const uint32_t kVertices = 1 << 5;
+const uint32_t kParticles = 1 << 6;
+const uint32_t kBeams = 1 << 7;
+} // namespace Needs
+
+// The per-event quantities inspected by the event-level rules. Each is
+// fetched at most once per event, regardless of how many rules use it, and
+// only if an active rule needs it. Instances are intended to be reused
+// between events so that the containers keep their capacity.
+struct EventFields {
+  // Available for rules that need more than is extracted here, may be null
+  // if the fields were not filled from a HepMC3::GenEvent.
+  HepMC3::GenEvent const *evt = nullptr;
+  // The text that the fields were filled from, empty if they were filled from
+  // a HepMC3::GenEvent.
+  RawEvent raw;
+
+  int evnum = 0;
+  AttributeField<int> ProcID;
+  AttributeField<std::vector<double>> LabPos;
+  AttributeField<double> TotXS;
+  AttributeField<double> ProcXS;
+  bool has_cross_section = false;
+  std::vector<int> vertex_statuses;
+  std::vector<int> particle_statuses;
+  size_t nbeams = 0;
+
+  // Scratch space for FillEventFields(RawEvent const &, ...)
+  std::vector<int> implicit_vertex_parents;
+};
+
+struct Rule {
+  // e.g. "E.R.2"
+  std::string id;
+  // Conventions are only checked when declared in NuHepMC.Conventions,
+  // requirements are always checked.
+  bool is_convention;
+  uint32_t needs;
+  // Returns true if the event passes. why is only non-null when the caller
+  // wants a description of a failure, checks should not spend any effort
+  // describing the failure otherwise.
+  std::function<bool(EventFields const &, RunDefinitions const &,
+                     std::ostream *why)>
+      check;
+};
+
+template <typename AT, typename T>
+inline void FillAttributeField(HepMC3::GenEvent const &evt,
+                               AttributeHandle<AT> const &handle,
+                               AttributeField<T> &f) {
+  auto attr = handle.Get(&evt);
+  if (attr) {
+    f.value = attr->value();
+    f.ok = true;
+    f.error = AttributeError::kNone;
+    return;
+  }
+
+  f.ok = false;
+  f.error = HasAttribute(&evt, handle.GetName()) ? AttributeError::kWrongType
+                                                 : AttributeError::kMissing;
+}
+
+inline void FillEventFields(HepMC3::GenEvent const &evt, uint32_t needs,
+                            EventFields &f) {
+  static const AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+  static const AttributeHandle<HepMC3::VectorDoubleAttribute> LabPos("LabPos");
+  static const AttributeHandle<HepMC3::DoubleAttribute> TotXS("TotXS");
+  static const AttributeHandle<HepMC3::DoubleAttribute> ProcXS("ProcXS");
+  NuHepMC_PROFILE_SCOPE("Validation.FillEventFields");
+
+  f.evt = &evt;
+  f.raw = RawEvent();
+  f.evnum = evt.event_number();
+
+  if (needs & Needs::kProcID) {
+    FillAttributeField(evt, ProcID, f.ProcID);
+  }
+  if (needs & Needs::kLabPos) {
+    FillAttributeField(evt, LabPos, f.LabPos);
+  }
+  if (needs & Needs::kTotXS) {
+    FillAttributeField(evt, TotXS, f.TotXS);
+  }
+  if (needs & Needs::kProcXS) {
+    FillAttributeField(evt, ProcXS, f.ProcXS);
+  }
+  if (needs & Needs::kCrossSection) {
+    f.has_cross_section = bool(evt.cross_section());
+  }
+  if (needs & Needs::kVertices) {
+    f.vertex_statuses.clear();
+    for (auto const &vtx : evt.vertices()) {
+      f.vertex_statuses.push_back(vtx->status());
+    }
+  }
+  if (needs & Needs::kParticles) {
+    f.particle_statuses.clear();
+    for (auto const &part : evt.particles()) {
+      f.particle_statuses.push_back(part->status());
+    }
+  }
+  if (needs & Needs::kBeams) {
+    f.nbeams = evt.beams().size();
+  }
+}
+
+// Fills f directly from the text of an Asciiv3 event, without building a
+// HepMC3::GenEvent. The fields are those that FillEventFields would extract
+// from the GenEvent that HepMC3::ReaderAscii builds from the same text:
+//  * event attributes are parsed with the conversions that HepMC3 uses,
+//  * a particle whose parent is another particle rather than a vertex was
+//    written with an implicit, status 0, production vertex, which the reader
+//    recreates, one per distinct parent particle,
+//  * beam particles are the particles that have no parent.
+// f.evt is set to nullptr.
+inline void FillEventFields(RawEvent const &evt, uint32_t needs,
+                            EventFields &f) {
+  NuHepMC_PROFILE_SCOPE("Validation.FillEventFields");
+  f.evt = nullptr;
+  f.raw = evt;
+  f.evnum = evt.evnum;
+  f.ProcID.ok = false;
+  f.ProcID.error = AttributeError::kMissing;
+  f.LabPos.ok = false;
+  f.LabPos.error = AttributeError::kMissing;
+  f.LabPos.value.clear();
+  f.TotXS.ok = false;
+  f.TotXS.error = AttributeError::kMissing;
+  f.ProcXS.ok = false;
+  f.ProcXS.error = AttributeError::kMissing;
+  f.has_cross_section = false;
+  f.vertex_statuses.clear();
+  f.particle_statuses.clear();
+  f.nbeams = 0;
+  f.implicit_vertex_parents.clear();
+
+  bool const need_vertices = needs & Needs::kVertices;
+  bool const need_particles = needs & Needs::kParticles;
+  bool const need_beams = needs & Needs::kBeams;
+
+  evt.ForEachLine([&](char const *line, char const *eol) {
+    char const *p = line + 1;
+    switch (*line) {
+    case 'A': {
+      long id;
+      if (!Ascii::ParseInt(p, eol, id) || id) {
+        return;
+      }
+      p = Ascii::SkipBlanks(p, eol);
+      char const *name_end = Ascii::TokenEnd(p, eol);
+      auto IsName = [&](char const *name, size_t len) {
+        return (size_t(name_end - p) == len) && !std::memcmp(p, name, len);
+      };
+
+      if ((needs & Needs::kProcID) && IsName("ProcID", 6)) {
+        long v = 0;
+        p = name_end;
+        Ascii::ParseInt(p, eol, v);
+        f.ProcID.value = int(v);
+        f.ProcID.ok = true;
+        f.ProcID.error = AttributeError::kNone;
+      } else if ((needs & Needs::kLabPos) && IsName("LabPos", 6)) {
+        p = name_end;
+        double v;
+        while (Ascii::ParseDouble(p, eol, v)) {
+          f.LabPos.value.push_back(v);
+        }
+        f.LabPos.ok = true;
+        f.LabPos.error = AttributeError::kNone;
+      } else if ((needs & Needs::kTotXS) && IsName("TotXS", 5)) {
+        double v = 0;
+        p = name_end;
+        Ascii::ParseDouble(p, eol, v);
+        f.TotXS.value = v;
+        f.TotXS.ok = true;
+        f.TotXS.error = AttributeError::kNone;
+      } else if ((needs & Needs::kProcXS) && IsName("ProcXS", 6)) {
+        double v = 0;
+        p = name_end;
+        Ascii::ParseDouble(p, eol, v);
+        f.ProcXS.value = v;
+        f.ProcXS.ok = true;
+        f.ProcXS.error = AttributeError::kNone;
+      } else if (IsName("GenCrossSection", 15)) {
+        f.has_cross_section = true;
+      }
+      return;
+    }
+    case 'V': {
+      if (!need_vertices) {
+        return;
+      }
+      long status = 0;
+      Ascii::SkipToken(p, eol);
+      Ascii::ParseInt(p, eol, status);
+      f.vertex_statuses.push_back(int(status));
+      return;
+    }
+    case 'P': {
+      if (!(need_vertices || need_particles || need_beams)) {
+        return;
+      }
+      long parent = 0, status = 0;
+      Ascii::SkipToken(p, eol);
+      Ascii::ParseInt(p, eol, parent);
+      if (parent == 0) {
+        f.nbeams++;
+      } else if (parent > 0) {
+        f.implicit_vertex_parents.push_back(int(parent));
+      }
+      if (need_particles) {
+        // pid, px, py, pz, e, m
+        for (int i = 0; i < 6; ++i) {
+          Ascii::SkipToken(p, eol);
+        }
+        Ascii::ParseInt(p, eol, status);
+        f.particle_statuses.push_back(int(status));
+      }
+      return;
+    }
+    default: {
+      return;
+    }
+    }
+  });
+
+  if (need_vertices) {
+    auto &parents = f.implicit_vertex_parents;
+    std::sort(parents.begin(), parents.end());
+    size_t nimplicit =
+        std::unique(parents.begin(), parents.end()) - parents.begin();
+    f.vertex_statuses.insert(f.vertex_statuses.end(), nimplicit, 0);
+  }
+}
+
+// Returns the message of the exception that ThrowAttributeError would throw
+// for the event-level attribute, name, of the event that f was filled from.
+// For an event filled from its text, the known attributes are those of the
+// event-level (id 0) attribute lines, which the reader would store in sorted
+// order.
+inline std::string DescribeAttributeError(EventFields const &f,
+                                          std::string const &name,
+                                          AttributeError error) {
+  if (error == AttributeError::kWrongType) {
+    AttributeTypeException ate;
+    ate << name << ": " << (f.evt ? f.evt->attribute_as_string(name) : "");
+    return ate.what();
+  }
+
+  std::set<std::string> names;
+  if (f.evt) {
+    for (auto const &a : f.evt->attribute_names()) {
+      names.insert(a);
+    }
+  } else {
+    f.raw.ForEachLine([&](char const *line, char const *eol) {
+      char const *p = line + 1;
+      long id;
+      if ((*line != 'A') || !Ascii::ParseInt(p, eol, id) || id) {
+        return;
+      }
+      p = Ascii::SkipBlanks(p, eol);
+      names.emplace(p, Ascii::TokenEnd(p, eol));
+    });
+  }
+
+  MissingAttributeException mae;
+  mae << "Failed to find attribute: " << name;
+  mae << "\n\tKnown attributes: \n";
+  for (auto const &a : names) {
+    mae << "\t\t" << a << "\n";
+  }
+  return mae.what();
+}
+
+// The built-in event-level rules, in the order that they are checked.
+inline std::vector<Rule> &EventRules() {
+  static std::vector<Rule> rules = {
+      {"E.R.2", false, Needs::kProcID,
+       [](EventFields const &f, RunDefinitions const &defs,
+          std::ostream *why) {
+         if (!f.ProcID.ok) {
+           if (why) {
+             (*why) << "Subexception: (\n"
+                    << DescribeAttributeError(f, "ProcID", f.ProcID.error)
+                    << " ).\n[FAILED] Event " << f.evnum
+                    << " -- E.R.2 Process ID";
+           }
+           return false;
+         }
+         if (!defs.ProcessIds.count(f.ProcID.value)) {
+           if (why) {
+             (*why) << "Process " << f.ProcID.value
+                    << " was not declared.\n[FAILED] Event " << f.evnum
+                    << " -- E.R.2 Process ID";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.R.4", false, Needs::kLabPos,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (!f.LabPos.ok) {
+           if (why) {
+             (*why) << "Subexception: (\n"
+                    << DescribeAttributeError(f, "LabPos", f.LabPos.error)
+                    << " ).\n[FAILED] Event " << f.evnum
+                    << " -- E.R.4 Lab Position";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.R.5", false, Needs::kVertices,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         int nprimvtx = 0;
+         for (int status : f.vertex_statuses) {
+           if (status == VertexStatus::kPrimaryVertex) {
+             nprimvtx++;
+           }
+           if (status == 0) {
+             if (why) {
+               (*why) << "Found vertex with status == 0.\n[FAILED] Event "
+                      << f.evnum << " -- E.R.5 Vertices";
+             }
+             return false;
+           }
+         }
+         if (nprimvtx != 1) {
+           if (why) {
+             (*why) << "Found " << nprimvtx
+                    << " Primary vertices.\n[FAILED] Event " << f.evnum
+                    << " -- E.R.5 Vertices";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.R.6", false, Needs::kBeams,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (f.nbeams < 1) {
+           if (why) {
+             (*why) << "Event contained no beam particles.\n[FAILED] Event "
+                    << f.evnum << " -- E.R.6 Beam Particle";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.C.2", true, Needs::kTotXS,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (!f.TotXS.ok) {
+           if (why) {
+             (*why) << "Subexception: (\n"
+                    << DescribeAttributeError(f, "TotXS", f.TotXS.error)
+                    << " ).\n[FAILED] Event " << f.evnum
+                    << " -- E.C.2 Total Cross Section";
+           }
+           return false;
+         }
+         if (f.TotXS.value == -1) {
+           if (why) {
+             (*why) << "[FAILED] Event " << f.evnum
+                    << " -- E.C.2 Total Cross Section";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.C.3", true, Needs::kProcXS,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (f.ProcXS.error == AttributeError::kWrongType) {
+           if (why) {
+             (*why) << "Subexception: (\n"
+                    << DescribeAttributeError(f, "ProcXS", f.ProcXS.error)
+                    << " ).\n[FAILED] Event " << f.evnum
+                    << " -- E.C.3 Process Cross Section";
+           }
+           return false;
+         }
+         // A missing ProcXS fails in the same way as one set to -1
+         if (!f.ProcXS.ok || (f.ProcXS.value == -1)) {
+           if (why) {
+             (*why) << "[FAILED] Event " << f.evnum
+                    << " -- E.C.3 Process Cross Section";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.C.4", true, Needs::kCrossSection,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (!f.has_cross_section) {
+           if (why) {
+             (*why) << "[FAILED] Event " << f.evnum
+                    << " -- E.C.4 Estimated Cross Section";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"E.C.6", true, Needs::kLabPos,
+       [](EventFields const &f, RunDefinitions const &, std::ostream *why) {
+         if (!f.LabPos.ok) {
+           if (why) {
+             (*why) << "Subexception: (\n"
+                    << DescribeAttributeError(f, "LabPos", f.LabPos.error)
+                    << " ).\n[FAILED] Event " << f.evnum
+                    << " -- E.C.6 Lab Position Time";
+           }
+           return false;
+         }
+         if (f.LabPos.value.size() != 4) {
+           if (why) {
+             (*why) << "[FAILED] Event " << f.evnum
+                    << " -- E.C.6 Lab Position Time";
+           }
+           return false;
+         }
+         return true;
+       }},
+      {"V.R.1", false, Needs::kVertices,
+       [](EventFields const &f, RunDefinitions const &defs,
+          std::ostream *why) {
+         for (int status : f.vertex_statuses) {
+           if ((status != VertexStatus::kPrimaryVertex) &&
+               !defs.VertexStatuses.count(status)) {
+             if (why) {
+               (*why) << "Vertex status " << status
+                      << " was not declared in the GenRunInfo.\n[FAILED] "
+                         "Event "
+                      << f.evnum << " -- V.R.1 Vertex Status Codes";
+             }
+             return false;
+           }
+         }
+         return true;
+       }},
+      {"P.R.1", false, Needs::kParticles,
+       [](EventFields const &f, RunDefinitions const &defs,
+          std::ostream *why) {
+         for (int status : f.particle_statuses) {
+           if (status >= 20) {
+             if (!defs.ParticleStatuses.count(status)) {
+               if (why) {
+                 (*why) << "Particle status " << status
+                        << " was not declared in the GenRunInfo but was used "
+                           "in event.\n[FAILED] Event "
+                        << f.evnum << " -- P.R.1 Particle Status Codes";
+               }
+               return false;
+             }
+           } else if (status > 11) {
+             if (why) {
+               (*why) << "Particle status " << status
+                      << " is reserved but unused. " << f.evnum
+                      << "\n[FAILED] P.R.1 Particle Status Codes";
+             }
+             return false;
+           } else if (status < 1) {
+             if (why) {
+               (*why) << "Particle status " << status
+                      << " is invalid is event.\n[FAILED] Event " << f.evnum
+                      << " -- P.R.1 Particle Status Codes";
+             }
+             return false;
+           }
+         }
+         return true;
+       }},
+  };
+  return rules;
+}
+
+// Adds a rule to the set checked by every subsequently constructed
+// ValidationPlan. Rules are checked in the order that they were registered.
+inline void RegisterEventRule(Rule rule) {
+  EventRules().push_back(std::move(rule));
+}
+
+// The set of event-level rules that apply to a given file, resolved once from
+// the declared conventions so that the per-event loop only runs the active
+// rules and only fetches the fields that they need.
+class ValidationPlan {
+public:
+  ValidationPlan(std::set<std::string> const &conventions,
+                 RunDefinitions definitions)
+      : definitions(std::move(definitions)), needs(0), serial(NextSerial()) {
+    for (auto const &rule : EventRules()) {
+      if (rule.is_convention && !conventions.count(rule.id)) {
+        continue;
+      }
+      active.push_back(rule);
+      needs |= rule.needs;
+      probes.push_back(
+          Profiling::Register("Rule." + rule.id, Profiling::Kind::kTimer));
+    }
+  }
+
+  uint32_t GetNeeds() const { return needs; }
+  std::vector<Rule> const &GetActiveRules() const { return active; }
+  RunDefinitions const &GetDefinitions() const { return definitions; }
+  // The profiling timer of each active rule
+  std::vector<Profiling::ProbeId> const &GetProbes() const { return probes; }
+  // Unique to each constructed plan and shared by its copies, which have the
+  // same active rules, so that per-plan caches can tell plans apart.
+  uint64_t GetSerial() const { return serial; }
+
+  bool IsActive(std::string const &id) const {
+    for (auto const &rule : active) {
+      if (rule.id == id) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns the first active rule that the event fails, or nullptr if it
+  // passes all of them.
+  Rule const *Check(EventFields const &f) const {
+    for (size_t i = 0; i < active.size(); ++i) {
+      NuHepMC_PROFILE_TIMER(probes[i]);
+      if (!active[i].check(f, definitions, nullptr)) {
+        return &active[i];
+      }
+    }
+    return nullptr;
+  }
+
+  std::string Describe(Rule const &rule, EventFields const &f) const {
+    std::stringstream ss;
+    rule.check(f, definitions, &ss);
+    return ss.str();
+  }
+
+private:
+  static uint64_t NextSerial() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+  }
+
+  RunDefinitions definitions;
+  std::vector<Rule> active;
+  std::vector<Profiling::ProbeId> probes;
+  uint32_t needs;
+  uint64_t serial;
+};
+
+// Used as the file position of failures of rules that are not associated with
+// a single event.
+const size_t kNoEvent = std::numeric_limits<size_t>::max();
+
+struct RuleFailure {
+  // The 0-based position of the event in the file, or kNoEvent.
+  size_t seq;
+  int evnum;
+  std::string why;
+};
+
+struct RuleStats {
+  std::string id;
+  uint64_t nchecked = 0;
+  uint64_t nfailed = 0;
+  // The earliest failures in the file, at most max_failures of them.
+  std::vector<RuleFailure> first_failures;
+};
+
+// Accumulates per-rule check and failure counts rather than stopping at the
+// first failure. Only the earliest max_failures failures of each rule are
+// described, any further failure of that rule costs a counter increment.
+//
+// A report is not thread-safe. Multi-threaded validation should give each
+// worker its own report and Merge them afterwards, the merged report does not
+// depend on how events were shared between the workers so long as each worker
+// sees its events in file order.
+class ValidationReport {
+public:
+  explicit ValidationReport(size_t max_failures = 10)
+      : max_failures(max_failures) {}
+
+  // plan_stats points into stats, which a moved-from deque hands over intact
+  // but a copy would not.
+  ValidationReport(ValidationReport const &) = delete;
+  ValidationReport &operator=(ValidationReport const &) = delete;
+  ValidationReport(ValidationReport &&) = default;
+  ValidationReport &operator=(ValidationReport &&) = default;
+
+  // Returned references remain valid for the lifetime of the report.
+  RuleStats &GetStats(std::string const &id) {
+    for (auto &st : stats) {
+      if (st.id == id) {
+        return st;
+      }
+    }
+    stats.emplace_back();
+    stats.back().id = id;
+    return stats.back();
+  }
+
+  // describe is only invoked if the failure will be stored.
+  template <typename F>
+  void Record(RuleStats &st, bool passed, size_t seq, int evnum,
+              F const &describe) {
+    st.nchecked++;
+    if (passed) {
+      return;
+    }
+    st.nfailed++;
+    if (st.first_failures.size() < max_failures) {
+      st.first_failures.push_back(RuleFailure{seq, evnum, describe()});
+    }
+  }
+
+  void Record(RuleStats &st, bool passed) {
+    Record(st, passed, kNoEvent, 0, []() { return std::string(); });
+  }
+
+  // Checks f against every active rule in plan, returns true if all passed.
+  bool CheckEvent(ValidationPlan const &plan, EventFields const &f,
+                  size_t seq) {
+    auto const &rules = plan.GetActiveRules();
+    if (plan_serial != plan.GetSerial()) {
+      plan_serial = plan.GetSerial();
+      plan_stats.clear();
+      for (auto const &rule : rules) {
+        plan_stats.push_back(&GetStats(rule.id));
+      }
+    }
+
+    bool passed = true;
+    for (size_t i = 0; i < rules.size(); ++i) {
+      NuHepMC_PROFILE_TIMER(plan.GetProbes()[i]);
+      bool rule_passed =
+          rules[i].check(f, plan.GetDefinitions(), nullptr);
+      Record(*plan_stats[i], rule_passed, seq, f.evnum,
+             [&]() { return plan.Describe(rules[i], f); });
+      passed = passed && rule_passed;
+    }
+    return passed;
+  }
+
+  void Merge(ValidationReport const &other) {
+    for (auto const &ost : other.stats) {
+      auto &st = GetStats(ost.id);
+      st.nchecked += ost.nchecked;
+      st.nfailed += ost.nfailed;
+      st.first_failures.insert(st.first_failures.end(),
+                               ost.first_failures.begin(),
+                               ost.first_failures.end());
+      std::stable_sort(st.first_failures.begin(), st.first_failures.end(),
+                       [](RuleFailure const &a, RuleFailure const &b) {
+                         return a.seq < b.seq;
+                       });
+      if (st.first_failures.size() > max_failures) {
+        st.first_failures.resize(max_failures);
+      }
+    }
+  }
+
+  std::deque<RuleStats> const &GetStats() const { return stats; }
+
+  void Clear() {
+    stats.clear();
+    plan_stats.clear();
+    plan_serial = 0;
+  }
+
+  // Writes the counts and stored failures of every rule in a binary form, so
+  // that a later process can continue the report.
+  void Write(std::ostream &os) const {
+    BinaryIO::WritePOD(os, uint64_t(stats.size()));
+    for (auto const &st : stats) {
+      BinaryIO::WriteString(os, st.id);
+      BinaryIO::WritePOD(os, st.nchecked);
+      BinaryIO::WritePOD(os, st.nfailed);
+      BinaryIO::WritePOD(os, uint64_t(st.first_failures.size()));
+      for (auto const &fail : st.first_failures) {
+        BinaryIO::WritePOD(os, uint64_t(fail.seq));
+        BinaryIO::WritePOD(os, int32_t(fail.evnum));
+        BinaryIO::WriteString(os, fail.why);
+      }
+    }
+  }
+
+  // Replaces the contents with a report written by Write. Returns false,
+  // leaving the report empty, if the stream is truncated or malformed.
+  bool Read(std::istream &is) {
+    Clear();
+    uint64_t nstats = BinaryIO::ReadPOD<uint64_t>(is);
+    for (uint64_t i = 0; is && (i < nstats); ++i) {
+      RuleStats st;
+      st.id = BinaryIO::ReadString(is);
+      st.nchecked = BinaryIO::ReadPOD<uint64_t>(is);
+      st.nfailed = BinaryIO::ReadPOD<uint64_t>(is);
+      uint64_t nfailures = BinaryIO::ReadPOD<uint64_t>(is);
+      for (uint64_t j = 0; is && (j < nfailures); ++j) {
+        RuleFailure fail;
+        fail.seq = size_t(BinaryIO::ReadPOD<uint64_t>(is));
+        fail.evnum = BinaryIO::ReadPOD<int32_t>(is);
+        fail.why = BinaryIO::ReadString(is);
+        st.first_failures.push_back(std::move(fail));
+      }
+      if (st.first_failures.size() > max_failures) {
+        st.first_failures.resize(max_failures);
+      }
+      stats.push_back(std::move(st));
+    }
+    if (!is) {
+      Clear();
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t GetNFailed() const {
+    uint64_t nfailed = 0;
+    for (auto const &st : stats) {
+      nfailed += st.nfailed;
+    }
+    return nfailed;
+  }
+
+  void WriteJSON(std::ostream &os, std::string const &filename,
+                 size_t nevents) const {
+    os << "{\n  \"file\": " << JSONQuote(filename)
+       << ",\n  \"nevents\": " << nevents
+       << ",\n  \"passed\": " << (GetNFailed() ? "false" : "true")
+       << ",\n  \"rules\": [";
+    for (size_t i = 0; i < stats.size(); ++i) {
+      auto const &st = stats[i];
+      os << (i ? "," : "") << "\n    {\n      \"id\": " << JSONQuote(st.id)
+         << ",\n      \"checked\": " << st.nchecked
+         << ",\n      \"failed\": " << st.nfailed
+         << ",\n      \"first_failures\": [";
+      for (size_t j = 0; j < st.first_failures.size(); ++j) {
+        auto const &fail = st.first_failures[j];
+        os << (j ? "," : "") << "\n        {";
+        if (fail.seq != kNoEvent) {
+          os << "\"position\": " << fail.seq << ", \"event\": " << fail.evnum
+             << ", ";
+        }
+        os << "\"message\": " << JSONQuote(fail.why) << "}";
+      }
+      os << (st.first_failures.size() ? "\n      ]" : "]") << "\n    }";
+    }
+    os << (stats.size() ? "\n  ]" : "]") << "\n}" << std::endl;
+  }
+
+private:
+
+  size_t max_failures;
+  std::deque<RuleStats> stats;
+  // The stats entries for each of the active rules of the last plan seen by
+  // CheckEvent, identified by its serial, so that the per-event path does not
+  // look up rules by id.
+  std::vector<RuleStats *> plan_stats;
+  uint64_t plan_serial = 0;
+};
+
+} // namespace Validation
+} // namespace NuHepMC
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "NuHepMC/AsciiScanner.hxx"
+#include "NuHepMC/BinaryIO.hxx"
+#include "NuHepMC/EventIndex.hxx"
+#include "NuHepMC/EventNumberTracker.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/Profiling.hxx"
+#include "NuHepMC/Validation.hxx"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(CheckpointException);
+
+// The state of the validation of the first events of an Asciiv3 file, saved
+// to a sidecar file (GetSidecarName) so that a later run can validate only the
+// events appended since, or continue after being interrupted.
+//
+// The checkpoint records where the validated events end, the E.R.1 event
+// number set and the event-level rule counts. The file is fingerprinted by a
+// hash of its header, i.e. the run info, and of the last validated event, and
+// IsValidFor rejects the checkpoint if either has changed.
+class ValidationCheckpoint {
+public:
+  // Options that change what is recorded, a checkpoint is only reused by a
+  // run with the same flags and the same max_failures.
+  enum Flags : uint32_t { kCollectAll = 1 };
+
+  static std::string GetSidecarName(std::string const &filename) {
+    return filename + ".nuhepmcckpt";
+  }
+
+  explicit ValidationCheckpoint(size_t max_failures)
+      : max_failures(max_failures), recorded_max_failures(max_failures),
+        report(max_failures) {}
+
+  // Starts again from the first event of the file that scanner is over.
+  void Reset(AsciiEventScanner const &scanner, uint32_t flags) {
+    char const *begin = scanner.GetHeaderBegin();
+    header_end = uint64_t(scanner.GetHeaderEnd() - begin);
+    header_hash = HashBytes(begin, header_end);
+    offset = header_end;
+    last_event_begin = header_end;
+    last_event_hash = HashBytes(nullptr, 0);
+    nevents = 0;
+    this->flags = flags;
+    recorded_max_failures = max_failures;
+    event_numbers.Clear();
+    report.Clear();
+  }
+
+  // Records that every event up to and including last, a further nvalidated
+  // events, has been validated. file_begin is the start of the mapped file.
+  void Advance(char const *file_begin, RawEvent const &last,
+               size_t nvalidated) {
+    last_event_begin = uint64_t(last.begin - file_begin);
+    offset = uint64_t(last.end - file_begin);
+    last_event_hash = HashBytes(last.begin, size_t(last.end - last.begin));
+    nevents += nvalidated;
+  }
+
+  // Checks that the checkpoint still describes the file that scanner is
+  // over, as mapped by file.
+  bool IsValidFor(MappedFile const &file, AsciiEventScanner const &scanner,
+                  uint32_t flags, std::string *why = nullptr) const {
+    auto Fail = [&](std::string const &reason) {
+      if (why) {
+        *why = reason;
+      }
+      return false;
+    };
+
+    if (flags != this->flags) {
+      return Fail("it was written with different options");
+    }
+    if (recorded_max_failures != max_failures) {
+      return Fail("it was written with a different failure limit");
+    }
+    char const *begin = file.begin();
+    if ((uint64_t(scanner.GetHeaderEnd() - begin) != header_end) ||
+        (HashBytes(begin, header_end) != header_hash)) {
+      return Fail("the run info has changed");
+    }
+    if (file.GetSize() < offset) {
+      return Fail("the file is shorter than the validated events");
+    }
+    if (HashBytes(begin + last_event_begin, offset - last_event_begin) !=
+        last_event_hash) {
+      return Fail("the last validated event has changed");
+    }
+    return true;
+  }
+
+  // Written to a temporary file that then replaces checkpoint_file, so that
+  // an interruption leaves either the old or the new checkpoint. The contents
+  // are followed by their hash, so that corruption is detected by Read.
+  void Write(std::string const &checkpoint_file) const {
+    NuHepMC_PROFILE_SCOPE("Checkpoint.Write");
+    std::ostringstream oss;
+    oss.write(kMagic, sizeof(kMagic));
+    BinaryIO::WritePOD(oss, kVersion);
+    BinaryIO::WritePOD(oss, flags);
+    BinaryIO::WritePOD(oss, recorded_max_failures);
+    BinaryIO::WritePOD(oss, header_end);
+    BinaryIO::WritePOD(oss, header_hash);
+    BinaryIO::WritePOD(oss, offset);
+    BinaryIO::WritePOD(oss, last_event_begin);
+    BinaryIO::WritePOD(oss, last_event_hash);
+    BinaryIO::WritePOD(oss, nevents);
+    event_numbers.Write(oss);
+    report.Write(oss);
+    std::string contents = oss.str();
+
+    std::string tmp = checkpoint_file + ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::binary);
+      ofs.write(contents.data(), contents.size());
+      BinaryIO::WritePOD(ofs, HashBytes(contents.data(), contents.size()));
+      if (!ofs.flush()) {
+        throw CheckpointException() << "Failed to write " << tmp;
+      }
+    }
+    if (std::rename(tmp.c_str(), checkpoint_file.c_str())) {
+      throw CheckpointException()
+          << "Failed to replace " << checkpoint_file << " with " << tmp;
+    }
+  }
+
+  void Read(std::string const &checkpoint_file) {
+    std::ifstream ifs(checkpoint_file, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(ifs)),
+                         std::istreambuf_iterator<char>());
+    uint64_t hash = 0;
+    if (contents.size() >= sizeof(hash)) {
+      std::memcpy(&hash, contents.data() + contents.size() - sizeof(hash),
+                  sizeof(hash));
+      contents.resize(contents.size() - sizeof(hash));
+    }
+
+    std::istringstream iss(contents);
+    char magic[sizeof(kMagic)];
+    iss.read(magic, sizeof(magic));
+    if (!iss || std::memcmp(magic, kMagic, sizeof(kMagic))) {
+      throw CheckpointException()
+          << checkpoint_file << " is not a NuHepMC validation checkpoint.";
+    }
+    if (HashBytes(contents.data(), contents.size()) != hash) {
+      throw CheckpointException() << checkpoint_file << " is corrupt.";
+    }
+    uint32_t version = BinaryIO::ReadPOD<uint32_t>(iss);
+    if (version != kVersion) {
+      throw CheckpointException()
+          << checkpoint_file << " has unsupported version " << version;
+    }
+    flags = BinaryIO::ReadPOD<uint32_t>(iss);
+    recorded_max_failures = BinaryIO::ReadPOD<uint64_t>(iss);
+    header_end = BinaryIO::ReadPOD<uint64_t>(iss);
+    header_hash = BinaryIO::ReadPOD<uint64_t>(iss);
+    offset = BinaryIO::ReadPOD<uint64_t>(iss);
+    last_event_begin = BinaryIO::ReadPOD<uint64_t>(iss);
+    last_event_hash = BinaryIO::ReadPOD<uint64_t>(iss);
+    nevents = BinaryIO::ReadPOD<uint64_t>(iss);
+    if (!iss || !event_numbers.Read(iss) || !report.Read(iss) ||
+        (last_event_begin > offset) || (header_end > last_event_begin)) {
+      throw CheckpointException() << checkpoint_file << " is corrupt.";
+    }
+  }
+
+  // The validated events are the bytes [GetHeaderEnd(), GetOffset()).
+  uint64_t GetHeaderEnd() const { return header_end; }
+  uint64_t GetOffset() const { return offset; }
+  uint64_t GetNEvents() const { return nevents; }
+
+  EventNumberTracker &GetEventNumbers() { return event_numbers; }
+  Validation::ValidationReport &GetReport() { return report; }
+
+private:
+  static constexpr char kMagic[8] = {'N', 'u', 'H', 'e', 'p', 'C', 'k', 'p'};
+  static constexpr uint32_t kVersion = 2;
+
+  uint32_t flags = 0;
+  // The number of failures described for each rule by this run, and by the
+  // run that wrote the checkpoint
+  uint64_t max_failures;
+  uint64_t recorded_max_failures;
+  uint64_t header_end = 0;
+  uint64_t header_hash = 0;
+  uint64_t offset = 0;
+  uint64_t last_event_begin = 0;
+  uint64_t last_event_hash = 0;
+  uint64_t nevents = 0;
+  EventNumberTracker event_numbers;
+  Validation::ValidationReport report;
+
+};
+
+} // namespace NuHepMC
@@ -0,0 +1,326 @@
+#pragma once
+
+#include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/GenRunInfo.h"
+
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/ReaderUtils.hxx"
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NuHepMC {
+
+NEW_NuHepMC_EXCEPT(WeightMatrixException);
+
+namespace Weights {
+
+enum class Layout {
+  // The weights of each event are contiguous.
+  kRowMajor,
+  // The values of each weight over the events of the batch are contiguous.
+  kColumnMajor
+};
+
+// A batch of events x weights, filled from GenEvent::weights() through
+// indices resolved once from GenRunInfo::weight_names() (G.R.7), rather than
+// by a GenEvent::weight(name) lookup per weight per event.
+//
+//   NuHepMC::Weights::WeightMatrix matrix(reader.run_info());
+//   NuHepMC::Weights::WeightSums sums(matrix.NWeights());
+//   while (reader.read_event(evt), !reader.failed()) {
+//     if (matrix.Add(evt)) {
+//       sums.Accumulate(matrix);
+//       matrix.Clear();
+//     }
+//   }
+//   sums.Accumulate(matrix);
+//
+// The ProcID (E.R.2) and event number of each event are kept alongside the
+// weights.
+class WeightMatrix {
+public:
+  // names selects and orders the columns of the matrix, all of the weights
+  // declared by run_info are used, in order, if it is empty.
+  WeightMatrix(std::shared_ptr<HepMC3::GenRunInfo> const &run_info,
+               std::vector<std::string> const &names = {},
+               size_t batch_size = 4096, Layout layout = Layout::kRowMajor)
+      : batch_size(batch_size), layout(layout) {
+    if (!run_info) {
+      throw WeightMatrixException() << "No GenRunInfo to read the weight "
+                                       "names from.";
+    }
+    if (!batch_size) {
+      throw WeightMatrixException() << "The batch size must be at least 1.";
+    }
+
+    auto const &declared = run_info->weight_names();
+    ndeclared = declared.size();
+    if (names.empty()) {
+      this->names = declared;
+      for (size_t i = 0; i < ndeclared; ++i) {
+        indices.push_back(i);
+      }
+    } else {
+      this->names = names;
+      for (auto const &name : names) {
+        auto it = std::find(declared.begin(), declared.end(), name);
+        if (it == declared.end()) {
+          throw WeightMatrixException()
+              << "Weight \"" << name
+              << "\" is not declared in the GenRunInfo weight names.";
+        }
+        indices.push_back(size_t(it - declared.begin()));
+      }
+    }
+
+    contiguous = true;
+    for (size_t i = 0; i < indices.size(); ++i) {
+      contiguous = contiguous && (indices[i] == (indices.front() + i));
+    }
+
+    values.resize(batch_size * indices.size());
+    procids.reserve(batch_size);
+    evnums.reserve(batch_size);
+  }
+
+  // Appends the selected weights of evt to the batch and returns true if the
+  // batch is now full. Throws WeightMatrixException if the batch is already
+  // full or evt has fewer weights than the run info declares, and
+  // MissingAttributeException if evt has no ProcID.
+  bool Add(HepMC3::GenEvent const &evt) {
+    static const AttributeHandle<HepMC3::IntAttribute> ProcID("ProcID");
+
+    if (Full()) {
+      throw WeightMatrixException()
+          << "Tried to add event " << evt.event_number()
+          << " to a full batch of " << batch_size << " events.";
+    }
+    auto const &w = evt.weights();
+    if (w.size() < ndeclared) {
+      throw WeightMatrixException()
+          << "Event " << evt.event_number() << " has " << w.size()
+          << " weights, but the GenRunInfo declares " << ndeclared << ".";
+    }
+
+    size_t n = NEvents();
+    size_t nw = indices.size();
+    if (layout == Layout::kRowMajor) {
+      double *row = values.data() + (n * nw);
+      if (contiguous && nw) {
+        std::copy_n(w.data() + indices.front(), nw, row);
+      } else {
+        for (size_t j = 0; j < nw; ++j) {
+          row[j] = w[indices[j]];
+        }
+      }
+    } else {
+      for (size_t j = 0; j < nw; ++j) {
+        values[(j * batch_size) + n] = w[indices[j]];
+      }
+    }
+
+    procids.push_back(ProcID.Value(&evt));
+    evnums.push_back(evt.event_number());
+    return Full();
+  }
+
+  // Empties the batch, keeping its memory.
+  void Clear() {
+    procids.clear();
+    evnums.clear();
+  }
+
+  size_t NEvents() const { return procids.size(); }
+  size_t NWeights() const { return indices.size(); }
+  size_t BatchSize() const { return batch_size; }
+  bool Full() const { return NEvents() == batch_size; }
+  bool Empty() const { return procids.empty(); }
+  Layout GetLayout() const { return layout; }
+
+  std::vector<std::string> const &GetNames() const { return names; }
+  std::vector<int> const &GetProcIDs() const { return procids; }
+  std::vector<int> const &GetEventNumbers() const { return evnums; }
+
+  double operator()(size_t event, size_t weight) const {
+    return (layout == Layout::kRowMajor)
+               ? values[(event * indices.size()) + weight]
+               : values[(weight * batch_size) + event];
+  }
+
+  // The start of the storage, laid out as GetLayout(). Consecutive events of
+  // a row-major matrix, or consecutive weights of a column-major matrix, are
+  // Stride() doubles apart.
+  double const *data() const { return values.data(); }
+  size_t Stride() const {
+    return (layout == Layout::kRowMajor) ? indices.size() : batch_size;
+  }
+
+  // The NWeights() weights of an event of a row-major matrix
+  double const *Row(size_t event) const {
+    if (layout != Layout::kRowMajor) {
+      throw WeightMatrixException() << "Row called on a column-major matrix.";
+    }
+    return values.data() + (event * indices.size());
+  }
+
+  // The NEvents() values of a weight of a column-major matrix
+  double const *Column(size_t weight) const {
+    if (layout != Layout::kColumnMajor) {
+      throw WeightMatrixException() << "Column called on a row-major matrix.";
+    }
+    return values.data() + (weight * batch_size);
+  }
+
+private:
+  size_t batch_size;
+  Layout layout;
+  size_t ndeclared = 0;
+  std::vector<std::string> names;
+  // Position in GenEvent::weights() of each column
+  std::vector<size_t> indices;
+  // indices is a run of consecutive positions, so a row can be copied whole
+  bool contiguous = false;
+
+  std::vector<double> values;
+  std::vector<int> procids;
+  std::vector<int> evnums;
+};
+
+struct WeightSum {
+  size_t nevents = 0;
+  // Per weight, the sum of the weights and of their squares
+  std::vector<double> sum;
+  std::vector<double> sum2;
+
+  explicit WeightSum(size_t nweights = 0)
+      : sum(nweights, 0), sum2(nweights, 0) {}
+
+  WeightSum &operator+=(WeightSum const &other) {
+    nevents += other.nevents;
+    for (size_t j = 0; j < sum.size(); ++j) {
+      sum[j] += other.sum[j];
+      sum2[j] += other.sum2[j];
+    }
+    return *this;
+  }
+};
+
+// Per-ProcID sums and sums of squares of each weight of a WeightMatrix.
+class WeightSums {
+public:
+  explicit WeightSums(size_t nweights) : nweights(nweights) {}
+
+  void Accumulate(WeightMatrix const &m) {
+    if (m.NWeights() != nweights) {
+      throw WeightMatrixException()
+          << "Tried to accumulate a matrix of " << m.NWeights()
+          << " weights into sums of " << nweights << " weights.";
+    }
+    if (m.GetLayout() == Layout::kRowMajor) {
+      AccumulateRows(m);
+    } else {
+      AccumulateColumns(m);
+    }
+  }
+
+  // Adds the sums of another set, e.g. one filled on another thread.
+  void Merge(WeightSums const &other) {
+    if (other.nweights != nweights) {
+      throw WeightMatrixException()
+          << "Tried to merge sums of " << other.nweights
+          << " weights into sums of " << nweights << " weights.";
+    }
+    for (auto const &proc : other.byprocid) {
+      Get(proc.first) += proc.second;
+    }
+  }
+
+  size_t NWeights() const { return nweights; }
+  std::map<int, WeightSum> const &GetByProcID() const { return byprocid; }
+
+  // The sums over every ProcID
+  WeightSum GetTotal() const {
+    WeightSum total(nweights);
+    for (auto const &proc : byprocid) {
+      total += proc.second;
+    }
+    return total;
+  }
+
+private:
+  size_t nweights;
+  std::map<int, WeightSum> byprocid;
+
+  // Scratch space for AccumulateColumns
+  std::vector<std::pair<int, size_t>> order;
+
+  WeightSum &Get(int procid) {
+    auto it = byprocid.find(procid);
+    if (it == byprocid.end()) {
+      it = byprocid.emplace(procid, WeightSum(nweights)).first;
+    }
+    return it->second;
+  }
+
+  // Each row is added to the sums of its ProcID, the inner loop runs over
+  // contiguous weights and is vectorized.
+  void AccumulateRows(WeightMatrix const &m) {
+    auto const &procids = m.GetProcIDs();
+    WeightSum *s = nullptr;
+    for (size_t i = 0; i < m.NEvents(); ++i) {
+      if (!s || (procids[i] != procids[i - 1])) {
+        s = &Get(procids[i]);
+      }
+      s->nevents++;
+      double const *row = m.data() + (i * nweights);
+      double *sum = s->sum.data();
+      double *sum2 = s->sum2.data();
+      for (size_t j = 0; j < nweights; ++j) {
+        sum[j] += row[j];
+        sum2[j] += row[j] * row[j];
+      }
+    }
+  }
+
+  // The events of the batch are grouped by ProcID once, then each column is
+  // reduced over each group.
+  void AccumulateColumns(WeightMatrix const &m) {
+    auto const &procids = m.GetProcIDs();
+    order.clear();
+    for (size_t i = 0; i < m.NEvents(); ++i) {
+      order.emplace_back(procids[i], i);
+    }
+    std::sort(order.begin(), order.end());
+
+    for (size_t begin = 0; begin < order.size();) {
+      size_t end = begin;
+      while ((end < order.size()) && (order[end].first == order[begin].first)) {
+        end++;
+      }
+      WeightSum &s = Get(order[begin].first);
+      s.nevents += end - begin;
+      for (size_t j = 0; j < nweights; ++j) {
+        double const *col = m.data() + (j * m.Stride());
+        double sum = 0, sum2 = 0;
+        for (size_t k = begin; k < end; ++k) {
+          double w = col[order[k].second];
+          sum += w;
+          sum2 += w * w;
+        }
+        s.sum[j] += sum;
+        s.sum2[j] += sum2;
+      }
+      begin = end;
+    }
+  }
+};
+
+} // namespace Weights
+} // namespace NuHepMC
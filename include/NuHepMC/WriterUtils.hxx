@@ -3,13 +3,26 @@
 #include "HepMC3/GenRunInfo.h"
 
 #include "HepMC3/Attribute.h"
+#include "HepMC3/GenEvent.h"
+#include "HepMC3/Writer.h"
+#include "HepMC3/WriterAscii.h"
 
 #include "NuHepMC/Constants.hxx"
+#include "NuHepMC/EventPipeline.hxx"
+#include "NuHepMC/Exceptions.hxx"
+#include "NuHepMC/Profiling.hxx"
 #include "NuHepMC/Types.hxx"
 
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace NuHepMC {
@@ -78,4 +91,179 @@ inline void WriteNuHepMCVersion(std::shared_ptr<HepMC3::GenRunInfo> &run_info) {
 }
 
 } // namespace GenRunInfo
+
+const char kAsciiv3Footer[] = "HepMC::Asciiv3-END_EVENT_LISTING\n\n";
+
+// The text that HepMC3::WriterAscii writes ahead of the first event for
+// run_info, for tools that assemble Asciiv3 files from existing event text.
+inline std::string
+FormatAsciiv3Header(std::shared_ptr<HepMC3::GenRunInfo> run_info) {
+  std::stringstream ss;
+  {
+    HepMC3::WriterAscii writer(ss, run_info);
+    writer.close();
+  }
+  std::string header = ss.str();
+  auto footer = header.rfind("HepMC::Asciiv3-END_EVENT_LISTING");
+  if (footer != std::string::npos) {
+    header.resize(footer);
+  }
+  return header;
+}
+
+NEW_NuHepMC_EXCEPT(AsyncWriterException);
+
+// Writes events to a HepMC3::Writer on a background thread, so that
+// formatting and I/O overlap with building the next events.
+//
+// Events are handed over by unique_ptr and are written in the order that
+// Write was called. HepMC3 writers are not thread-safe and the output must
+// keep that order, so a single thread owns the wrapped writer. At most
+// queue_depth events wait to be written, beyond that Write blocks, which
+// bounds the memory held by a producer that outpaces the output. Spent
+// events are cleared and can be reused through GetEvent.
+//
+// A failure of the underlying writer is rethrown from the next call to Write,
+// Flush or Close, events handed over after a failure are discarded.
+class AsyncWriter {
+public:
+  explicit AsyncWriter(std::shared_ptr<HepMC3::Writer> writer,
+                       size_t queue_depth = 16)
+      : writer(std::move(writer)), queue_depth(queue_depth ? queue_depth : 1),
+        queue(queue_depth),
+        thread([this]() { Serialize(); }) {}
+
+  AsyncWriter(AsyncWriter const &) = delete;
+  AsyncWriter &operator=(AsyncWriter const &) = delete;
+
+  ~AsyncWriter() {
+    try {
+      Close();
+    } catch (std::exception &e) {
+      std::cout << "[ERROR]: AsyncWriter: " << e.what() << std::endl;
+    }
+  }
+
+  // Safe to call from multiple threads.
+  void Write(std::unique_ptr<HepMC3::GenEvent> evt) {
+    if (!evt) {
+      throw AsyncWriterException() << "Write passed a null event.";
+    }
+    RethrowFailure();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (closed) {
+        throw AsyncWriterException() << "Write called after Close.";
+      }
+      nsubmitted++;
+    }
+    bool pushed;
+    {
+      NuHepMC_PROFILE_SCOPE("Output.WaitForWriter");
+      pushed = queue.Push(std::move(evt));
+    }
+    if (!pushed) {
+      std::lock_guard<std::mutex> lock(mutex);
+      nsubmitted--;
+      all_written.notify_all();
+      throw AsyncWriterException() << "Write called after Close.";
+    }
+  }
+
+  // Returns a previously written event, cleared, or a new one if none are
+  // available.
+  std::unique_ptr<HepMC3::GenEvent> GetEvent() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (spent.empty()) {
+      return std::make_unique<HepMC3::GenEvent>();
+    }
+    auto evt = std::move(spent.back());
+    spent.pop_back();
+    return evt;
+  }
+
+  // Blocks until every event passed to Write so far has been written.
+  void Flush() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      all_written.wait(lock, [this] { return nwritten == nsubmitted; });
+    }
+    RethrowFailure();
+  }
+
+  // Writes any outstanding events, stops the background thread and closes
+  // the wrapped writer. Further calls have no effect.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (closed) {
+        return;
+      }
+      closed = true;
+    }
+    queue.Close();
+    thread.join();
+    writer->close();
+    RethrowFailure();
+  }
+
+private:
+  std::shared_ptr<HepMC3::Writer> writer;
+  size_t queue_depth;
+  BoundedQueue<std::unique_ptr<HepMC3::GenEvent>> queue;
+
+  std::mutex mutex;
+  std::condition_variable all_written;
+  size_t nsubmitted = 0;
+  size_t nwritten = 0;
+  bool closed = false;
+  std::exception_ptr failure;
+  std::vector<std::unique_ptr<HepMC3::GenEvent>> spent;
+
+  // Declared last so that everything it uses exists before it starts.
+  std::thread thread;
+
+  void RethrowFailure() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  void Serialize() {
+    std::unique_ptr<HepMC3::GenEvent> evt;
+    while (queue.Pop(evt)) {
+      bool failed;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = bool(failure);
+      }
+
+      if (!failed) {
+        try {
+          NuHepMC_PROFILE_SCOPE("Output.WriteEvent");
+          writer->write_event(*evt);
+          if (writer->failed()) {
+            throw AsyncWriterException()
+                << "HepMC3 writer failed while writing event "
+                << evt->event_number();
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          failure = std::current_exception();
+        }
+      }
+      evt->clear();
+
+      std::lock_guard<std::mutex> lock(mutex);
+      // Enough to keep a producer that recycles through GetEvent supplied.
+      if (spent.size() <= queue_depth) {
+        spent.push_back(std::move(evt));
+      }
+      nwritten++;
+      all_written.notify_all();
+    }
+  }
+};
+
 } // namespace NuHepMC
\ No newline at end of file